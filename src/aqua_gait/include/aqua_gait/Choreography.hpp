@@ -0,0 +1,120 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef CHOREOGRAPHY_HPP_
+#define CHOREOGRAPHY_HPP_
+
+
+#include <string>
+#include <vector>
+#include "aqua_gait/Gaits.hpp"
+
+
+/**
+ * Precompiled leg choreography: a dense, time-indexed table of per-leg motor
+ * targets (angle, velocity, acceleration), sampled at a fixed period.
+ *
+ * A choreography is described by keyframes, each of which starts a new
+ * periodic leg command on one leg (or all legs), in the same parameterization
+ * as PeriodicLegCommand and LegChoreographies.TimedLegState:
+ *
+ *   angle(t) = amplitude*cos(2*pi*frequency*(t - t_key) + phase_offset)
+ *            + leg_offset + leg_velocity*(t - t_key)
+ *
+ * Keyframes stay in effect until the next keyframe on the same leg. Before
+ * its first keyframe, a leg stays at angle 0.
+ *
+ * compile() evaluates this once into the table. Playback via sample() is then
+ * O(1) per tick: one table index and a cubic Hermite interpolation of the
+ * angle between two neighbouring samples (velocity and acceleration are
+ * interpolated linearly). Looping and time scaling are applied at playback.
+ *
+ * TEXT FORMAT (see load()); '#' starts a comment:
+ *
+ *   period 0.001                  # optional table period in seconds (default 1 ms)
+ *   duration 4.0                  # required, length of the choreography in seconds
+ *   key <t> <leg|*> <amplitude_rad> <frequency_hz> <phase_offset_rad> <leg_offset_rad> [<leg_velocity_radps>]
+ */
+class LegChoreography {
+public:
+  struct Keyframe_t {
+    double t;
+    int leg; // 0-5, or -1 for all legs
+    float amplitude;
+    float frequency;
+    float phase_offset;
+    float leg_offset;
+    float leg_velocity;
+  };
+
+
+  LegChoreography() : period(0.001), length(0), loop(false), timeScale(1.0) {};
+
+
+  /** Builds the table from keyframes (in any order); returns false if the input is invalid */
+  bool compile(const std::vector<Keyframe_t>& keyframes, double duration, double period = 0.001);
+
+  /** Parses and compiles a choreography file; on failure, returns false and sets error */
+  bool load(const std::string& path, std::string& error);
+
+
+  void setLoop(bool enabled) { loop = enabled; };
+  bool getLoop() const { return loop; };
+
+  /** Playback speed factor; 2.0 plays the choreography twice as fast */
+  void setTimeScale(double scale) { timeScale = (scale > 0) ? scale : 1.0; };
+  double getTimeScale() const { return timeScale; };
+
+  bool empty() const { return table.empty(); };
+  /** Length of one playback in seconds, after time scaling */
+  double getDuration() const { return length/timeScale; };
+
+
+  /**
+   * Fills target with the choreographed motor targets at 'elapsed' seconds
+   * since the start of playback. Returns false (leaving target untouched)
+   * before the start, or after the end of a non-looping choreography.
+   */
+  bool sample(double elapsed, MotorTarget_t (&target)[6]) const;
+
+
+protected:
+  double period;
+  double length;
+  bool loop;
+  double timeScale;
+
+  std::vector<MotorTarget_t> table; // 6 targets per sample, indexed by [sample*6 + leg]
+};
+
+
+#endif // #ifndef CHOREOGRAPHY_HPP_
@@ -0,0 +1,151 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef GAIT_BATCH_HPP_
+#define GAIT_BATCH_HPP_
+
+
+#include <vector>
+#include "aqua_gait/Gaits.hpp"
+
+
+/**
+ * Batched version of UnderwaterSwimmerGait: advances the gait state of N robots
+ * in a single call.
+ *
+ * All state is stored in structure-of-arrays form: per-leg quantities live in
+ * arrays of 6*N values indexed by [leg*N + robot], per-robot quantities in
+ * arrays of N values. Every update loops over robots in the innermost loop
+ * and works in preallocated buffers, so updates never allocate. The loop
+ * bodies are scalar: they call atan2, pow, sin and cos per element, and the
+ * compiler does not vectorize them.
+ *
+ * Each robot follows the same logic as an UnderwaterSwimmerGait instance with
+ * the same configuration, except that all robots share the time passed to the
+ * update functions (read once per call). Zero-crossing updates
+ * (FS_ZERO_CROSSING) are not supported.
+ *
+ * HOW TO USE UnderwaterSwimmerGaitBatch?
+ *
+ * - create an object for N robots, passing the same configuration parameters
+ *   as for UnderwaterSwimmerGait
+ * - call activate(now)
+ * - set per-robot commands with setBodyCmd(), foreaftControl(), setPeriodicLegCmd()
+ * - repeatedly call updateSineCmd(now) and updateMotorTarget(now); results are
+ *   in the sine* and target* arrays, or can be copied per robot with
+ *   getSineCmd() and getMotorTarget()
+ */
+class UnderwaterSwimmerGaitBatch {
+public:
+  UnderwaterSwimmerGaitBatch(
+      size_t numRobots,
+      float defaultMaxAmplitudeRad = (20.0/180.0*M_PI),
+      float defaultFrequency = 2.5,
+      float defaultHoverParkAngleRad = M_PI/4,
+      float defaultHoverIIRTimeConstant = 0.03,
+      float defaultLinerizationFactor = 0.0
+  );
+
+
+  size_t size() const { return N; };
+  inline size_t idx(int leg, size_t robot) const { return leg*N + robot; };
+
+
+  void activate(double now);
+  void activate(size_t robot, double now);
+
+
+  void setBodyCmd(size_t robot, float speed, float heave, float roll, float pitch, float yaw);
+  void foreaftControl(size_t robot, int direction);
+  void setMaxAmplitudeRad(size_t robot, float rad) { maxAmplitudeRad[robot] = UnderwaterSwimmerGait::saturate(rad, 0, M_PI); };
+  void setFrequency(size_t robot, float hz) { frequencyHz[robot] = UnderwaterSwimmerGait::saturate(hz, 0, 4); };
+  void setPeriodicLegCmd(size_t robot, const PeriodicLegState_t& legsCmd);
+
+
+  /** Equivalent of UnderwaterSwimmerGait::updateSineCmd() for all robots; results in sine* */
+  void updateSineCmd(double now) { updateSineCmd(now, 0, N); };
+  /** Equivalent of UnderwaterSwimmerGait::updateMotorTarget() for all robots; results in target* */
+  void updateMotorTarget(double now) { updateMotorTarget(now, 0, N); };
+
+  /**
+   * Same as above, for robots in [begin, end) only. Disjoint ranges touch disjoint
+   * state, so they can be updated concurrently from different threads.
+   */
+  void updateSineCmd(double now, size_t begin, size_t end);
+  void updateMotorTarget(double now, size_t begin, size_t end);
+
+
+  void getSineCmd(size_t robot, PeriodicLegState_t& legsCmd) const;
+  void getMotorTarget(size_t robot, MotorTarget_t (&target)[6]) const;
+
+
+  // outputs of updateSineCmd(), indexed by idx(leg, robot)
+  std::vector<float> sineAmplitudes, sineFrequencies, sinePhaseOffsets, sineLegOffsets;
+  // outputs of updateMotorTarget(), indexed by idx(leg, robot)
+  std::vector<double> targetPos, targetVel;
+
+
+protected:
+  const size_t N;
+
+  // configuration, shared by all robots
+  const float foreAngle;
+  const float aftAngle;
+  const float linearizationFactor;
+  const float hoverSlewRate;
+  const float hoverParkAngle;
+  const float hoverIIRValue;
+  const float hoverKneePoint;
+
+  // per-robot state
+  std::vector<char> legsEnabled, swimBackwards;
+  std::vector<float> speedCmd, hoverPitchCommand, hoverRollCommand, hoverYawCommand, hoverHeaveCommand;
+  std::vector<float> maxAmplitudeRad, frequencyHz;
+  std::vector<double> latestUpdateSineCmdTime, FSLatestUpdateMotorTargetsTime;
+
+  // per-leg state
+  std::vector<float> leg_offset, desired_leg_offset, phase_offset, hover_offset, hoverAmp;
+  std::vector<double> FStsinstart;
+  std::vector<double> FSLatestPos, FSLatestVel;
+  std::vector<float> currAmplitudes, currFrequencies, currPhaseOffsets, currLegOffsets, currLegVelocities;
+  std::vector<float> tgtAmplitudes, tgtFrequencies, tgtPhaseOffsets, tgtLegOffsets, tgtLegVelocities;
+
+  // scratch buffers, so that updates never allocate
+  std::vector<float> scratchSlewRate;
+  std::vector<double> scratchDt, scratchSpeed, scratchAcc, scratchDownscale;
+  std::vector<double> scratchLegAcc; // per-leg acceleration before the squash of 3.3
+  std::vector<unsigned int> scratchMSEC;
+  std::vector<char> scratchUseEmpirical;
+};
+
+
+#endif // #ifndef GAIT_BATCH_HPP_
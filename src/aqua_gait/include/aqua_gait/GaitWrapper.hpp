@@ -0,0 +1,266 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef GAITWRAPPER_HPP_
+#define GAITWRAPPER_HPP_
+
+
+#include "aqua_gait/Gaits.hpp"
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <std_msgs/Bool.h>
+#include <std_srvs/Empty.h>
+#include <aquacore/Command.h>
+#include <aquacore/KeepAlive.h>
+#include <aquacore/PeriodicLegCommand.h>
+#include <chrono>
+#include <mutex>
+
+
+class GaitWrapper {
+public:
+  typedef std::chrono::steady_clock SteadyClock;
+
+
+  /**
+   * With intra_process set (nodelet), commands are published by pointer, so that
+   * subscribers in the same process receive them without serialization, and
+   * in event-driven mode a command is published from handleBodyCmd() directly;
+   * the owner then calls refresh() every 1/getSpinRate() seconds.
+   */
+  GaitWrapper(const ros::NodeHandle& n = ros::NodeHandle(),
+      const ros::NodeHandle& local_n = ros::NodeHandle("~"), bool intra_process = false) :
+      nh(n), local_nh(local_n), spin_rate(50), timeout_secs(3.0), event_driven(false),
+      intra_process(intra_process), publishing_cmds(false), body_cmd_pending(false) {
+    local_nh.param<double>("spin_rate", spin_rate, spin_rate);
+    local_nh.param<double>("timeout_secs", timeout_secs, timeout_secs);
+    local_nh.param<bool>("event_driven", event_driven, event_driven);
+    if (spin_rate <= 0) spin_rate = 50;
+    refresh_period = std::chrono::duration_cast<SteadyClock::duration>(
+        std::chrono::duration<double>(1.0/spin_rate));
+    next_refresh = SteadyClock::now();
+
+    plc_msg.header.frame_id = "aqua";
+    
+    reset_srv = local_nh.advertiseService("reset", &GaitWrapper::handleReset, this);
+    plc_pub = nh.advertise<aquacore::PeriodicLegCommand>("/aqua/periodic_leg_command", 100);
+    swim_backwards_sub = nh.subscribe("/aqua/swim_backwards", 1, &GaitWrapper::handleSwimBackwards, this);
+    body_cmd_sub = nh.subscribe("/aqua/command", 10, &GaitWrapper::handleBodyCmd, this);
+    keep_alive_sub = nh.subscribe("/aqua/keepalive", 10, &GaitWrapper::handleKeepAlive, this);
+    
+    reset();
+    
+    ROS_INFO_STREAM("Hover midoff node started");
+  };
+  
+  
+  ~GaitWrapper() {
+  };
+  
+  
+  void spin() {
+    if (event_driven) {
+      spinEventDriven();
+      return;
+    }
+
+    ros::Rate hz(spin_rate);
+    
+    while (ros::ok()) {
+      if (publishing_cmds) {
+        updateAndPublish();
+      }
+      
+      // Spin once and wait a bit
+      ros::spinOnce();
+      hz.sleep();
+    }
+  };
+
+
+  /**
+   * Publishes as soon as a new body command has been processed, and otherwise
+   * every 1/spin_rate seconds. The refresh deadline is kept on the steady
+   * clock and restarts after each publish, so commands do not wait for the
+   * polling phase.
+   */
+  void spinEventDriven() {
+    typedef SteadyClock Clock;
+    const Clock::duration period = refresh_period;
+    ros::CallbackQueue* queue = ros::getGlobalCallbackQueue();
+    Clock::time_point deadline = Clock::now() + period;
+
+    while (ros::ok()) {
+      Clock::time_point now = Clock::now();
+      if (now < deadline) {
+        // Returns as soon as callbacks are available, or at the deadline
+        queue->callAvailable(ros::WallDuration(std::chrono::duration<double>(deadline - now).count()));
+        now = Clock::now();
+      }
+
+      if (body_cmd_pending || now >= deadline) {
+        body_cmd_pending = false;
+        if (publishing_cmds) {
+          updateAndPublish();
+        }
+        deadline = now + period;
+      }
+    }
+  };
+
+
+  /**
+   * One refresh of the command stream, for owners of the loop other than
+   * spin() (i.e. the nodelet's timer). In event-driven mode, the refresh is
+   * skipped if a command was published less than 1/spin_rate seconds ago.
+   */
+  void refresh() {
+    SteadyClock::time_point now = SteadyClock::now();
+    if (event_driven && now < next_refresh) return;
+    if (publishing_cmds) {
+      updateAndPublish();
+    }
+    next_refresh = now + refresh_period;
+  };
+
+
+  double getSpinRate() const { return spin_rate; };
+
+
+protected:
+  void updateAndPublish() {
+    // Check for timeout
+    ros::Time now = ros::Time::now();
+    if ((now - latest_body_cmd_time).toSec() > timeout_secs) {
+      gait_mutex.lock();
+      gait.setBodyCmd(0, 0, 0, 0, 0);
+      gait_mutex.unlock();
+      latest_body_cmd_time = now;
+      publishing_cmds = false;
+    }
+
+    // Obtain new PLC command
+    gait_mutex.lock();
+    gait.updateSineCmd(plc);
+    gait_mutex.unlock();
+
+    // Publish PLC command, reusing the same message
+    for (int i = 0; i < 6; i++) {
+      plc_msg.amplitudes[i] = plc.amplitudes[i];
+      plc_msg.frequencies[i] = plc.frequencies[i];
+      plc_msg.phase_offsets[i] = plc.phase_offsets[i];
+      plc_msg.leg_offsets[i] = plc.leg_offsets[i];
+      plc_msg.leg_velocities[i] = plc.leg_velocities[i];
+    }
+    plc_msg.header.stamp = ros::Time::now();
+    if (intra_process) {
+      // Subscribers keep the published message, so hand out a copy
+      plc_pub.publish(aquacore::PeriodicLegCommandPtr(new aquacore::PeriodicLegCommand(plc_msg)));
+    } else {
+      plc_pub.publish(plc_msg);
+    }
+  };
+
+
+  void handleSwimBackwards(const std_msgs::Bool::ConstPtr& msg) {
+    gait_mutex.lock();
+    gait.foreaftControl(msg->data ? -1.0 : 1.0);
+    gait_mutex.unlock();
+  };
+
+
+  void handleBodyCmd(const aquacore::Command::ConstPtr& msg) {
+    gait_mutex.lock();
+    gait.setBodyCmd(msg->speed, msg->heave, msg->roll, msg->pitch, msg->yaw);
+    gait_mutex.unlock();
+    latest_body_cmd_time = ros::Time::now();
+    publishing_cmds = true;
+    if (intra_process && event_driven) {
+      updateAndPublish();
+      next_refresh = SteadyClock::now() + refresh_period;
+    } else {
+      body_cmd_pending = true;
+    }
+  };
+  
+  
+  void handleKeepAlive(const aquacore::KeepAlive::ConstPtr& msg) {
+    if (msg->keepalive) {
+      latest_body_cmd_time = ros::Time::now();
+    } else {
+      latest_body_cmd_time = ros::Time::now() - ros::Duration(2*timeout_secs);
+    }
+  };
+
+
+  bool handleReset(std_srvs::Empty::Request& req, std_srvs::Empty::Response& res) {
+    reset();
+    return true;
+  };
+  
+
+  void reset() {
+    gait_mutex.lock();
+    gait.activate();
+    gait_mutex.unlock();
+    publishing_cmds = false;
+  };
+  
+
+  ros::NodeHandle nh, local_nh;
+  ros::Subscriber swim_backwards_sub;
+  ros::Subscriber body_cmd_sub;
+  ros::Subscriber keep_alive_sub;
+  ros::Publisher plc_pub;
+  ros::ServiceServer reset_srv;
+  
+  UnderwaterSwimmerGait gait;
+  std::mutex gait_mutex;
+  
+  PeriodicLegState_t plc;
+  aquacore::PeriodicLegCommand plc_msg;
+  
+  double spin_rate;
+  double timeout_secs;
+  bool event_driven;
+  bool intra_process;
+  ros::Time latest_body_cmd_time;
+  SteadyClock::duration refresh_period;
+  SteadyClock::time_point next_refresh;
+  
+  bool publishing_cmds;
+  bool body_cmd_pending;
+};
+
+
+
+#endif // #ifndef GAITWRAPPER_HPP_
@@ -49,6 +49,104 @@ struct MotorTarget_t {
 };
 
 
+/** Implementation of transcendental functions in updateMotorTarget(); see GaitFastMath.hpp */
+enum GaitMathBackend {
+  GAIT_MATH_LIBM = 0, // exact, via libm
+  GAIT_MATH_FAST,     // polynomial approximations, no libm calls
+};
+
+
+/** Constants and stateless helpers shared by all UnderwaterSwimmerGaitT variants */
+class UnderwaterSwimmerGaitBase {
+public:
+  constexpr static double two_pi = 2*M_PI;
+
+
+  // Analogous to b - a, but handles angular wrap-arounds
+  inline static double FSAngularMag(double bRad, double aRad) {
+    double dRad = bRad - aRad + M_PI;
+    return (dRad > 0) ? dRad - floor(dRad/two_pi)*two_pi - M_PI : dRad - (floor(dRad/two_pi) + 1)*two_pi + M_PI;
+  };
+
+
+  inline static float FSPiAdjust(float rad) {
+    float wrap = (rad - std::floor(rad/two_pi)*two_pi);
+    return (wrap > M_PI) ? wrap - two_pi : wrap;
+  };
+
+
+  inline static double FSSigmoidSquashGain(double val, double thresh, double gain) {
+    double downscaleGain = 0.0;
+    if (fabs(val) > 2e-10) { // Prevent numerical instabilities
+      downscaleGain = thresh/val*(2.0/(1.0 + exp(-gain/thresh*val)) - 1.0);
+    }
+    return downscaleGain;
+  }
+
+
+  inline static double saturate(const double in, const double low, const double high) {
+    if (in < low) return low;
+    else if (in > high) return high;
+    return in;
+  };
+
+
+  // NOTE: RoboDevel's MMReadTime() actually starts counting @ program start, whereas this implementation starts counting at epoch
+  inline static double MMReadTime() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count() / 1.0e9;
+  };
+
+
+  // Monotonic alternative to MMReadTime(), unaffected by wall-clock adjustments
+  inline static double MMReadSteadyTime() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() / 1.0e9;
+  };
+};
+
+
+/**
+ * Compile-time gait feature switches. Derive from this struct and override
+ * individual members to instantiate a variant of UnderwaterSwimmerGaitT, e.g.
+ *
+ *   struct ZeroCrossingTraits : UnderwaterSwimmerGaitDefaultTraits {
+ *     static constexpr bool FS_ZERO_CROSSING = true;
+ *   };
+ *   UnderwaterSwimmerGaitT<ZeroCrossingTraits> gait;
+ *
+ * Each variant is a distinct type, so disabled branches are folded away by
+ * the compiler instead of being tested on every update.
+ */
+struct UnderwaterSwimmerGaitDefaultTraits {
+  static constexpr bool FS_ZERO_CROSSING = false; // If true, only update amplitude, frequency, and leg offset at zero crossing
+  // If true, when a frequency change occurs, tsinstart will be recomputed based on the phase of the previous command.
+  // WARNING: this will give a discrepancy from ideal case only when frequency changes
+  static constexpr bool FS_ZERO_CROSSING_UPDATE_TSINSTART_TO_MATCH_PHASE = false;
+
+  static constexpr bool FS_PHASE_OFFSET_USE_STATIC = false;
+
+  static constexpr double FS_MAX_FREQUENCY_HZ = 4.0;
+
+  // NOTE: empirically, adding a acceleration cap, whether via saturation or
+  // sigmoid squashing, adds a temporal lag when switching frequencies. Thus,
+  // suggest first we try no acceleration limiting, and only if that still
+  // causes the robot to surge, then we apply saturation (which seems to give
+  // less oscillatory response in velocity)
+  static constexpr bool FS_ALL_MOTORS_ACCELERATION_SQUASH_MAX = false; // if false, saturate
+  static constexpr double FS_ALL_MOTORS_ACCELERATION_SQUASH_GAIN = 2.0; // this gain is chosen so that the squashing function behaves near-linearly within [-maxThresh, maxThresh] range
+  static constexpr double FS_ALL_MOTORS_ACCELERATION_MAX = -1; // disable saturation and squashing
+  //static constexpr double FS_ALL_MOTORS_ACCELERATION_MAX = 6.0 * (20.0/180.0*M_PI)*(UnderwaterSwimmerGaitBase::two_pi*2.5)*(UnderwaterSwimmerGaitBase::two_pi*2.5)*2.0; // 20', 2.5Hz, hover-midoff case
+  //static constexpr double FS_ALL_MOTORS_ACCELERATION_MAX = 6.0 * (20.0/180.0*M_PI)*(UnderwaterSwimmerGaitBase::two_pi*4.0)*(UnderwaterSwimmerGaitBase::two_pi*4.0)*1.0; // 20', 4Hz, slightly conservative worst case
+  //static constexpr double FS_ALL_MOTORS_ACCELERATION_MAX = 6.0 * (35.0/180.0*M_PI)*(UnderwaterSwimmerGaitBase::two_pi*4.0)*(UnderwaterSwimmerGaitBase::two_pi*4.0)*1.0; // 35', 4Hz, worst case
+
+  static constexpr bool FS_ALL_MOTORS_VELOCITY_SQUASH_MAX = true; // if false, saturate
+  static constexpr double FS_ALL_MOTORS_VELOCITY_SQUASH_GAIN = 2.0; // this gain is chosen so that the squashing function behaves near-linearly within [-maxThresh, maxThresh] range
+  //static constexpr double FS_ALL_MOTORS_VELOCITY_MAX = -1; // disable saturation and squashing
+  static constexpr double FS_ALL_MOTORS_VELOCITY_MAX = 6.0 * (20.0/180.0*M_PI)*(UnderwaterSwimmerGaitBase::two_pi*2.5)*2.0; // 20', 2.5Hz, hover-midoff case
+  //static constexpr double FS_ALL_MOTORS_VELOCITY_MAX = 6.0 * (20.0/180.0*M_PI)*(UnderwaterSwimmerGaitBase::two_pi*4.0)*1.0; // 20', 4Hz, slighty conservative worst case
+  //static constexpr double FS_ALL_MOTORS_VELOCITY_MAX = 6.0 * (35.0/180.0*M_PI)*(UnderwaterSwimmerGaitBase::two_pi*4.0)*1.0; // 35', 4Hz, worst case
+};
+
+
 //
 /**
  * LEG INDICES:
@@ -85,6 +183,34 @@ struct PeriodicLegState_t {
 };
 
 
+/**
+ * Snapshot of the mutable state of an UnderwaterSwimmerGait, used to save and
+ * restore simulation episodes. Timestamps are stored relative to the gait's
+ * time function at the moment the snapshot was taken, so a snapshot can be
+ * restored after the clock has been reset or has moved on.
+ */
+struct UnderwaterSwimmerGaitState_t {
+  bool legsEnabled;
+  float leg_offset[6], desired_leg_offset[6], phase_offset[6];
+  float speedCmd;
+  float hoverPitchCommand;
+  float hoverRollCommand;
+  float hoverYawCommand;
+  float hoverHeaveCommand;
+  bool swimBackwards;
+  float maxAmplitudeRad;
+  float frequencyHz;
+  float hover_offset[6];
+  float hoverAmp[6];
+  double latestUpdateSineCmdAge; // seconds before the snapshot; negative if invalid
+  double FSLatestUpdateMotorTargetsAge; // seconds before the snapshot; negative if invalid
+  double FStsinstartAge[6];
+  MotorTarget_t FSLatestMotorTargets[6];
+  PeriodicLegState_t FSCurrPeriodicLegState;
+  PeriodicLegState_t FSTargetPeriodicLegState;
+};
+
+
 /**
  * HOW TO USE UnderwaterSwimmerGait?
  *
@@ -100,6 +226,9 @@ struct PeriodicLegState_t {
  *   setPeriodicLegCmd(const PeriodicLegState_t& legCmd), and
  *   updateMotorTarget(MotorTarget_t (&target)[6])
  *   - resulting per-leg motor commands are computed and stored in 'target' buffer, which is passed as input argument
+ *   - control loops that already hold a timestamp should call the overloads taking
+ *     'double now' instead; these never invoke the stored timeFn, so a single clock
+ *     read (steady, simulated, ...) can drive all updates of a tick
  *
  *
  *
@@ -116,73 +245,21 @@ struct PeriodicLegState_t {
  * - upon unpausing, the situation is similar to upon activate(), and expect that RD's filter
  *   will catch up to desired sine pos in ROS, within the first (few) sine waves
  */
-class UnderwaterSwimmerGait {
+template <typename Traits = UnderwaterSwimmerGaitDefaultTraits>
+class UnderwaterSwimmerGaitT : public UnderwaterSwimmerGaitBase {
 public:
-  constexpr static double two_pi = 2*M_PI;
-
-
-  constexpr static bool FS_ZERO_CROSSING = false; // If true, only update amplitude, frequency, and leg offset at zero crossing
-  // If true, when a frequency change occurs, tsinstart will be recomputed based on the phase of the previous command.
-  // WARNING: this will give a discrepancy from ideal case only when frequency changes
-  constexpr static bool FS_ZERO_CROSSING_UPDATE_TSINSTART_TO_MATCH_PHASE = false;
+  typedef Traits traits_type;
 
-  constexpr static bool FS_PHASE_OFFSET_USE_STATIC = false;
-
-  constexpr static double FS_MAX_FREQUENCY_HZ = 4.0;
-
-  // NOTE: empirically, adding a acceleration cap, whether via saturation or
-  // sigmoid squashing, adds a temporal lag when switching frequencies. Thus,
-  // suggest first we try no acceleration limiting, and only if that still
-  // causes the robot to surge, then we apply saturation (which seems to give
-  // less oscillatory response in velocity)
-  constexpr static bool FS_ALL_MOTORS_ACCELERATION_SQUASH_MAX = false; // if false, saturate
-  constexpr static double FS_ALL_MOTORS_ACCELERATION_SQUASH_GAIN = 2.0; // this gain is chosen so that the squashing function behaves near-linearly within [-maxThresh, maxThresh] range
-  constexpr static double FS_ALL_MOTORS_ACCELERATION_MAX = -1; // disable saturation and squashing
-  //constexpr static double FS_ALL_MOTORS_ACCELERATION_MAX = 6.0 * (20.0/180.0*M_PI)*(two_pi*2.5)*(two_pi*2.5)*2.0; // 20', 2.5Hz, hover-midoff case
-  //constexpr static double FS_ALL_MOTORS_ACCELERATION_MAX = 6.0 * (20.0/180.0*M_PI)*(two_pi*4.0)*(two_pi*4.0)*1.0; // 20', 4Hz, slightly conservative worst case
-  //constexpr static double FS_ALL_MOTORS_ACCELERATION_MAX = 6.0 * (35.0/180.0*M_PI)*(two_pi*4.0)*(two_pi*4.0)*1.0; // 35', 4Hz, worst case
-
-  constexpr static bool FS_ALL_MOTORS_VELOCITY_SQUASH_MAX = true; // if false, saturate
-  constexpr static double FS_ALL_MOTORS_VELOCITY_SQUASH_GAIN = 2.0; // this gain is chosen so that the squashing function behaves near-linearly within [-maxThresh, maxThresh] range
-  //constexpr static double FS_ALL_MOTORS_VELOCITY_MAX = -1; // disable saturation and squashing
-  constexpr static double FS_ALL_MOTORS_VELOCITY_MAX = 6.0 * (20.0/180.0*M_PI)*(two_pi*2.5)*2.0; // 20', 2.5Hz, hover-midoff case
-  //constexpr static double FS_ALL_MOTORS_VELOCITY_MAX = 6.0 * (20.0/180.0*M_PI)*(two_pi*4.0)*1.0; // 20', 4Hz, slighty conservative worst case
-  //constexpr static double FS_ALL_MOTORS_VELOCITY_MAX = 6.0 * (35.0/180.0*M_PI)*(two_pi*4.0)*1.0; // 35', 4Hz, worst case
-
-
-  // Analogous to b - a, but handles angular wrap-arounds
-  inline static double FSAngularMag(double bRad, double aRad) {
-    double dRad = bRad - aRad + M_PI;
-    return (dRad > 0) ? dRad - floor(dRad/two_pi)*two_pi - M_PI : dRad - (floor(dRad/two_pi) + 1)*two_pi + M_PI;
-  };
-
-
-  inline static float FSPiAdjust(float rad) {
-    float wrap = (rad - std::floor(rad/two_pi)*two_pi);
-    return (wrap > M_PI) ? wrap - two_pi : wrap;
-  };
-
-
-  inline static double FSSigmoidSquashGain(double val, double thresh, double gain) {
-    double downscaleGain = 0.0;
-    if (fabs(val) > 2e-10) { // Prevent numerical instabilities
-      downscaleGain = thresh/val*(2.0/(1.0 + exp(-gain/thresh*val)) - 1.0);
-    }
-    return downscaleGain;
-  }
-
-
-  inline static double saturate(const double in, const double low, const double high) {
-    if (in < low) return low;
-    else if (in > high) return high;
-    return in;
-  };
-
-
-  // NOTE: RoboDevel's MMReadTime() actually starts counting @ program start, whereas this implementation starts counting at epoch
-  inline static double MMReadTime() {
-    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count() / 1.0e9;
-  };
+  constexpr static bool FS_ZERO_CROSSING = Traits::FS_ZERO_CROSSING;
+  constexpr static bool FS_ZERO_CROSSING_UPDATE_TSINSTART_TO_MATCH_PHASE = Traits::FS_ZERO_CROSSING_UPDATE_TSINSTART_TO_MATCH_PHASE;
+  constexpr static bool FS_PHASE_OFFSET_USE_STATIC = Traits::FS_PHASE_OFFSET_USE_STATIC;
+  constexpr static double FS_MAX_FREQUENCY_HZ = Traits::FS_MAX_FREQUENCY_HZ;
+  constexpr static bool FS_ALL_MOTORS_ACCELERATION_SQUASH_MAX = Traits::FS_ALL_MOTORS_ACCELERATION_SQUASH_MAX;
+  constexpr static double FS_ALL_MOTORS_ACCELERATION_SQUASH_GAIN = Traits::FS_ALL_MOTORS_ACCELERATION_SQUASH_GAIN;
+  constexpr static double FS_ALL_MOTORS_ACCELERATION_MAX = Traits::FS_ALL_MOTORS_ACCELERATION_MAX;
+  constexpr static bool FS_ALL_MOTORS_VELOCITY_SQUASH_MAX = Traits::FS_ALL_MOTORS_VELOCITY_SQUASH_MAX;
+  constexpr static double FS_ALL_MOTORS_VELOCITY_SQUASH_GAIN = Traits::FS_ALL_MOTORS_VELOCITY_SQUASH_GAIN;
+  constexpr static double FS_ALL_MOTORS_VELOCITY_MAX = Traits::FS_ALL_MOTORS_VELOCITY_MAX;
 
 
   /**
@@ -193,15 +270,16 @@ public:
    * NOTE: all default values were obtained by reading from within RoboDevel's
    * update() while Ramius was swimming in HOVER_MIDOFF mode
    */
-  UnderwaterSwimmerGait(
+  UnderwaterSwimmerGaitT(
       std::function<double(void)> timeFn = std::function<double(void)>(nullptr),
       float defaultMaxAmplitudeRad = (20.0/180.0*M_PI),
       float defaultFrequency = 2.5,
       float defaultHoverParkAngleRad = M_PI/4,
       float defaultHoverIIRTimeConstant = 0.03, // Number of seconds needed for low pass filter to reduce original error down to ~36% (i.e. exp(-1)*100 %)
-      float defaultLinerizationFactor = 0.0
+      float defaultLinerizationFactor = 0.0,
+      GaitMathBackend mathBackend = GAIT_MATH_LIBM
   ) :
-    time((timeFn) ? timeFn : UnderwaterSwimmerGait::MMReadTime),
+    time((timeFn) ? timeFn : UnderwaterSwimmerGaitBase::MMReadTime),
     legsEnabled(false),
     foreAngle(0),
     aftAngle(M_PI),
@@ -219,7 +297,8 @@ public:
     hoverIIRValue(exp(-0.001/saturate(defaultHoverIIRTimeConstant, 0.001, 1))),
     hoverKneePoint(M_PI/4),
     latestUpdateSineCmdTime(-1), // -1: invalid time
-    FSLatestUpdateMotorTargetsTime(-1) // -1: invalid time
+    FSLatestUpdateMotorTargetsTime(-1), // -1: invalid time
+    mathBackend(mathBackend)
       {
     for (int i = 0; i < 6; i++) {
       leg_offset[i] = desired_leg_offset[i] = 0;
@@ -249,10 +328,11 @@ public:
   };
 
 
-  ~UnderwaterSwimmerGait() {};
+  ~UnderwaterSwimmerGaitT() {};
 
 
-  void activate();
+  void activate() { activate(time()); };
+  void activate(double now);
 
 
   void foreaftControl(int direction) {
@@ -269,6 +349,9 @@ public:
   int getForeAftDirection() { return (swimBackwards) ? -1 : 1; };
 
 
+  GaitMathBackend getMathBackend() { return mathBackend; };
+
+
   void setMaxAmplitudeRad(float rad) { // Only used to translate from speed/heave/roll/pitch/yaw to sine signal
     maxAmplitudeRad = saturate(rad, 0, M_PI);
   };
@@ -312,7 +395,8 @@ public:
   };
   float getYawCmd() { return hoverYawCommand; };
 
-  void updateSineCmd(PeriodicLegState_t& legsCmd);
+  void updateSineCmd(PeriodicLegState_t& legsCmd) { updateSineCmd(time(), legsCmd); };
+  void updateSineCmd(double now, PeriodicLegState_t& legsCmd);
 
 
   const PeriodicLegState_t& setPeriodicLegCmd(const PeriodicLegState_t& legsCmd) {
@@ -328,7 +412,14 @@ public:
 
     return FSTargetPeriodicLegState;
   };
-  void updateMotorTarget(MotorTarget_t (&target)[6]);
+  void updateMotorTarget(MotorTarget_t (&target)[6]) { updateMotorTarget(time(), target); };
+  void updateMotorTarget(double now, MotorTarget_t (&target)[6]);
+
+
+  void saveState(UnderwaterSwimmerGaitState_t& state) { saveState(time(), state); };
+  void saveState(double now, UnderwaterSwimmerGaitState_t& state);
+  void restoreState(const UnderwaterSwimmerGaitState_t& state) { restoreState(time(), state); };
+  void restoreState(double now, const UnderwaterSwimmerGaitState_t& state);
 
 
 protected:
@@ -385,7 +476,16 @@ protected:
 
   PeriodicLegState_t FSCurrPeriodicLegState;
   PeriodicLegState_t FSTargetPeriodicLegState;
+
+  const GaitMathBackend mathBackend;
 };
 
 
+typedef UnderwaterSwimmerGaitT<> UnderwaterSwimmerGait;
+
+// The default variant is compiled once in Gaits.cpp; other variants are
+// instantiated implicitly by including aqua_gait/GaitsImpl.hpp.
+extern template class UnderwaterSwimmerGaitT<UnderwaterSwimmerGaitDefaultTraits>;
+
+
 #endif // #ifndef GAITS_HPP_
@@ -0,0 +1,183 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef GAITS_COMMON_HPP_
+#define GAITS_COMMON_HPP_
+
+// Helpers shared by the UnderwaterSwimmerGait implementations (GaitsImpl.hpp, GaitBatch.cpp)
+
+#include "aqua_gait/Gaits.hpp"
+#include <algorithm>
+#include <cfloat>
+
+
+#define FLATTEN_FLIPPERS_ON_ZERO_BODY_COMMAND
+
+
+inline bool FSZeroCrossing( float time, float freq ) {
+  if (fabs(time - 3.0/4/freq) <= 0.005) {
+    return true;
+  } else if (fabs(time - 1.0/4/freq) <= 0.005) {
+    return true;
+  } else {
+    return false;
+  }
+};
+
+
+inline float FSIIR(float old, float in, float gain, unsigned int ms = 1) {
+  if (ms > 1) {
+    return UnderwaterSwimmerGaitBase::FSPiAdjust(in - pow(gain, ms)*UnderwaterSwimmerGaitBase::FSPiAdjust(in-old));
+  } else if (ms <= 0) {
+    return old;
+  }
+  return UnderwaterSwimmerGaitBase::FSPiAdjust(in - gain*UnderwaterSwimmerGaitBase::FSPiAdjust(in-old));
+};
+
+
+inline double sign(double a) {
+  if (a > 0) return 1;
+  else if (a < 0) return -1;
+  return 0;
+};
+
+
+inline float ratelinearization(float x, float alpha) {
+  return 2.0*sign(x)*alpha*(sqrt(1.0 + fabs(x)/alpha) - 1.0);
+};
+
+
+/**
+ * Equivalent of applying the rate-linearized low-pass filter
+ *   old = old + (1-gain)*ratelinearization(in - old, alpha)
+ * once per elapsed msec, in constant time. A single msec is computed exactly
+ * as above. Longer catch-ups use the continuous-time solution: with
+ * e = |in - old| and w = sqrt(1 + e/alpha) - 1, the filter follows
+ * dw/dt = -lambda*w/(w+1), i.e. w + ln(w) decreases linearly at rate
+ * lambda = -ln(gain) per msec. w is then recovered with Halley iterations
+ * (w = LambertW(exp(c))). Using -ln(gain) instead of 1-gain makes the small-error
+ * (linear) regime match FSIIR()'s pow(gain, ms) exactly; otherwise the result
+ * is within 1% of the step |in - old| of the per-msec loop.
+ */
+inline float FSRateLinearizedIIR(float old, float in, float gain, float alpha, unsigned int ms = 1) {
+  if (ms <= 0) {
+    return old;
+  } else if (ms == 1) {
+    return old + (1.0-gain)*ratelinearization((in - old), alpha);
+  }
+
+  const double err = in - old;
+  const double w0 = sqrt(1.0 + fabs(err)/alpha) - 1.0;
+  if (w0 <= 0) return in;
+
+  // Solve w + ln(w) = c for w > 0. After long gaps w ~ exp(c) underflows, and the
+  // remaining error (about 2*alpha*exp(c)) is far below float precision
+  const double c = w0 + log(w0) + log(gain)*ms;
+  if (c < -700.0) return in;
+  double w = (c > 1.0) ? c - log(c) : std::max(exp(c), DBL_MIN); // asymptotes for large and small w
+  for (int it = 0; it < 8; it++) {
+    // Halley step f/(f' - f*f''/(2*f')) with f' = (w+1)/w and f'' = -1/w^2, multiplied
+    // through by w so that neither derivative overflows for small w
+    double f = w + log(w) - c;
+    double step = f*w/((w + 1.0) + 0.5*f/(w + 1.0));
+    w -= step;
+    if (w <= 0) w = 1e-300;
+    if (fabs(step) <= 1e-12*w) break;
+  }
+
+  return in - sign(err)*alpha*w*(w + 2.0);
+};
+
+
+/*******************************************************************************
+ *                            ComputeOrientedThruster
+ * This function will compute what the individual action of a flipper should
+ * be in order to generate the proper forces. The basic idea is that the forces
+ * can be generated either by moving the surface in the proper direction (thus
+ * generating pressure drag in the somewhat right direction) or oscillating
+ * the surface to generate thrust. The change of behavior from one to the other
+ * is decided when the surface is at 45 deg of the demanded thrust direction.
+ * When no force is asked, the surface is "parked" slowly to parkAngle, in
+ * order to increase the reaction time if an opposite command is demanded.
+ * The variable slewRate will dictate how fast the surface is moved to generate
+ * the pressure drag, and therefore should be selected so it generate a drag
+ * compatible with the oscillation characteristics.
+ * ****************************************************************************/
+inline void ComputeOrientedThruster(float Xthrust, float Ythrust,
+    float offset, float *pLegAngle, float *pAmp,
+    float slewRate, float parkAngle, float kneePoint) {
+  float targetAngle, Magthrust;
+  float ratio, deltaAngle;
+
+  float nonSaturatedMagThrust = sqrt(Xthrust*Xthrust + Ythrust*Ythrust);
+
+  Xthrust = UnderwaterSwimmerGaitBase::saturate(Xthrust,-1.5,1.5);
+  Ythrust = UnderwaterSwimmerGaitBase::saturate(Ythrust,0.0,1.0);
+  targetAngle = atan2(Xthrust,Ythrust) + offset;
+  Magthrust = sqrt(Xthrust*Xthrust + Ythrust*Ythrust);
+  Magthrust = UnderwaterSwimmerGaitBase::saturate(Magthrust,0.0,1.5);
+  if (Magthrust < 0.05) {
+    // We want to bring the flippers to a +-45 deg parking position, so when
+    // a new command is required we have some margins.
+    if (nonSaturatedMagThrust > 0.1) {
+      // If there is a net command for other flippers, we should retract our flippers
+      targetAngle = 0.0;
+      slewRate = slewRate*0.2;
+    } else { // nonSaturatedMagThrust <= 0.1
+      targetAngle = UnderwaterSwimmerGaitBase::saturate((*pLegAngle), -parkAngle, parkAngle);
+      slewRate = slewRate*0.05;
+    }
+  } else {
+    slewRate = slewRate * Magthrust; // To make motion somewhat prop to demanded force
+  }
+
+  // If we are more than 45 deg away from target position, we cut-off
+  // the amplitude of the oscillation
+  //
+  // NOTE: the following LINEAR difference works only since targetAngle is
+  //       being saturated to -pi/pi (assuming offset = 0), and pLegAngle
+  //       follows targetAngle while limiting its rate of change (by +/- slewRate).
+  //       Ideally, we should be using an ANGULAR difference instead, although
+  //       that would add slightly more computation:
+  //
+  // deltaAngle = targetAngle - (*pLegAngle) + two_pi/2;
+  // deltaAngle = (deltaAngle > 0) ? deltaAngle - floor(deltaAngle/two_pi)*two_pi - two_pi/2 : deltaAngle - (floor(deltaAngle/two_pi) + 1)*two_pi + two_pi/2;
+  //
+  // a.k.a. deltaAngle = UnderwaterSwimmerGait::FSAngularMag(targetAngle, (*pLegAngle));
+  deltaAngle = targetAngle - (*pLegAngle);
+  ratio = UnderwaterSwimmerGaitBase::saturate((1 - fabs(deltaAngle) / (kneePoint)),0.0,1.0);
+  (*pAmp) = Magthrust * ratio;
+  (*pLegAngle) += UnderwaterSwimmerGaitBase::saturate(deltaAngle,-slewRate,slewRate);
+};
+
+
+#endif // #ifndef GAITS_COMMON_HPP_
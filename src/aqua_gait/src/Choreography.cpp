@@ -0,0 +1,160 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "aqua_gait/Choreography.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+
+bool LegChoreography::compile(const std::vector<Keyframe_t>& keyframes, double duration, double period) {
+  if (!(duration > 0) || !(period > 0) || duration/period > 1e8) return false;
+  for (const Keyframe_t& key : keyframes) {
+    if (key.leg < -1 || key.leg > 5 || key.t < 0) return false;
+  }
+
+  // Expand 'all legs' keyframes and sort each leg's keyframes by time
+  std::vector<Keyframe_t> legKeys[6];
+  for (const Keyframe_t& key : keyframes) {
+    for (int i = 0; i < 6; i++) {
+      if (key.leg == -1 || key.leg == i) legKeys[i].push_back(key);
+    }
+  }
+  for (int i = 0; i < 6; i++) {
+    std::stable_sort(legKeys[i].begin(), legKeys[i].end(),
+        [](const Keyframe_t& a, const Keyframe_t& b) { return a.t < b.t; });
+  }
+
+  // One extra sample past the end, so that interpolation never reads out of range
+  const size_t numSamples = (size_t) ceil(duration/period) + 1;
+  std::vector<MotorTarget_t> newTable(numSamples*6);
+  for (int i = 0; i < 6; i++) {
+    size_t k = 0; // index of the next keyframe on this leg
+    for (size_t s = 0; s < numSamples; s++) {
+      const double t = s*period;
+      while (k < legKeys[i].size() && legKeys[i][k].t <= t) k++;
+      MotorTarget_t& tar = newTable[s*6 + i];
+      if (k == 0) continue; // before the first keyframe: stay at 0
+
+      const Keyframe_t& key = legKeys[i][k - 1];
+      const double tk = t - key.t;
+      const double omega = UnderwaterSwimmerGaitBase::two_pi*key.frequency;
+      const double phase = omega*tk + key.phase_offset;
+      tar.pos = key.amplitude*cos(phase) + key.leg_offset + key.leg_velocity*tk;
+      tar.vel = -key.amplitude*omega*sin(phase) + key.leg_velocity;
+      tar.acc = -key.amplitude*omega*omega*cos(phase);
+    }
+  }
+
+  table.swap(newTable);
+  this->period = period;
+  length = duration;
+  return true;
+};
+
+
+bool LegChoreography::load(const std::string& path, std::string& error) {
+  FILE* f = fopen(path.c_str(), "r");
+  if (!f) {
+    error = "could not open " + path;
+    return false;
+  }
+
+  std::vector<Keyframe_t> keyframes;
+  double duration = -1, newPeriod = 0.001;
+  char line[512];
+  int lineNum = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), f)) {
+    lineNum++;
+    char* comment = strchr(line, '#');
+    if (comment) *comment = '\0';
+
+    char keyword[32], leg[8];
+    if (sscanf(line, "%31s", keyword) != 1) continue; // blank line
+
+    if (strcmp(keyword, "period") == 0) {
+      ok = (sscanf(line, "%*s %lf", &newPeriod) == 1);
+    } else if (strcmp(keyword, "duration") == 0) {
+      ok = (sscanf(line, "%*s %lf", &duration) == 1);
+    } else if (strcmp(keyword, "key") == 0) {
+      Keyframe_t key;
+      key.leg_velocity = 0;
+      int n = sscanf(line, "%*s %lf %7s %f %f %f %f %f", &key.t, leg, &key.amplitude,
+          &key.frequency, &key.phase_offset, &key.leg_offset, &key.leg_velocity);
+      ok = (n >= 6);
+      if (ok) {
+        key.leg = (strcmp(leg, "*") == 0) ? -1 : ((leg[0] >= '0' && leg[0] <= '5' && leg[1] == '\0') ? leg[0] - '0' : -2);
+        keyframes.push_back(key);
+      }
+    } else {
+      ok = false;
+    }
+    if (!ok) error = path + ":" + std::to_string(lineNum) + ": could not parse '" + keyword + "' line";
+  }
+  fclose(f);
+  if (!ok) return false;
+
+  if (!compile(keyframes, duration, newPeriod)) {
+    error = path + ": invalid duration, period or keyframe";
+    return false;
+  }
+  return true;
+};
+
+
+bool LegChoreography::sample(double elapsed, MotorTarget_t (&target)[6]) const {
+  if (table.empty() || elapsed < 0) return false;
+
+  double t = elapsed*timeScale;
+  if (t >= length) {
+    if (!loop) return false;
+    t -= floor(t/length)*length;
+  }
+
+  const double u = t/period;
+  size_t s = (size_t) u;
+  if (s >= table.size()/6 - 1) s = table.size()/6 - 2; // rounding at the very end
+  const double a = u - s;
+
+  // Cubic Hermite basis on [0, 1]; velocities are scaled from rad/s to rad/sample
+  const double a2 = a*a, a3 = a2*a;
+  const double h00 = 2*a3 - 3*a2 + 1, h10 = a3 - 2*a2 + a, h01 = -2*a3 + 3*a2, h11 = a3 - a2;
+  const MotorTarget_t* p0 = &table[s*6];
+  const MotorTarget_t* p1 = p0 + 6;
+  for (int i = 0; i < 6; i++) {
+    target[i].pos = h00*p0[i].pos + h10*period*p0[i].vel + h01*p1[i].pos + h11*period*p1[i].vel;
+    target[i].vel = ((1 - a)*p0[i].vel + a*p1[i].vel)*timeScale;
+    target[i].acc = ((1 - a)*p0[i].acc + a*p1[i].acc)*timeScale*timeScale;
+  }
+  return true;
+};
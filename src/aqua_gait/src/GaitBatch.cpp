@@ -0,0 +1,444 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "aqua_gait/GaitBatch.hpp"
+#include "aqua_gait/GaitsCommon.hpp"
+
+
+// Per-leg mixing of body commands into thruster directions, matching the six
+// hand-unrolled ComputeOrientedThruster() calls in UnderwaterSwimmerGait::updateSineCmd():
+//   Xthrust = rollSign*roll + pitchSign*pitch + d*heave
+//   Ythrust = d*yawSign*yaw + speed,  with d = -1 when swimming backwards, 1 otherwise
+static const float rollSign[6] = {1, 1, 1, -1, -1, -1};
+static const float pitchSign[6] = {-1, 0, 1, -1, 0, 1};
+static const float yawSign[6] = {1, 1, 1, -1, -1, -1};
+
+
+// floor() for finite values well within the range of long long; unlike std::floor it does
+// not need a libm call on targets without SSE4.1, and gives bit-identical results
+inline double batchFloor(double x) {
+  double f = (double)(long long)x;
+  return (f > x) ? f - 1 : f;
+};
+
+
+// Same arithmetic as UnderwaterSwimmerGait::FSPiAdjust, FSAngularMag and FSIIR, using batchFloor()
+inline float batchPiAdjust(float rad) {
+  float wrap = (rad - batchFloor(rad/UnderwaterSwimmerGait::two_pi)*UnderwaterSwimmerGait::two_pi);
+  return (wrap > M_PI) ? wrap - UnderwaterSwimmerGait::two_pi : wrap;
+};
+
+
+inline double batchAngularMag(double bRad, double aRad) {
+  const double two_pi = UnderwaterSwimmerGait::two_pi;
+  double dRad = bRad - aRad + M_PI;
+  return (dRad > 0) ? dRad - batchFloor(dRad/two_pi)*two_pi - M_PI : dRad - (batchFloor(dRad/two_pi) + 1)*two_pi + M_PI;
+};
+
+
+inline float batchIIR(float old, float in, float gain, unsigned int ms) {
+  if (ms > 1) {
+    return batchPiAdjust(in - pow(gain, ms)*batchPiAdjust(in-old));
+  } else if (ms <= 0) {
+    return old;
+  }
+  return batchPiAdjust(in - gain*batchPiAdjust(in-old));
+};
+
+
+static_assert(!UnderwaterSwimmerGait::FS_ZERO_CROSSING, "UnderwaterSwimmerGaitBatch does not implement zero-crossing updates");
+
+
+UnderwaterSwimmerGaitBatch::UnderwaterSwimmerGaitBatch(
+    size_t numRobots,
+    float defaultMaxAmplitudeRad,
+    float defaultFrequency,
+    float defaultHoverParkAngleRad,
+    float defaultHoverIIRTimeConstant,
+    float defaultLinerizationFactor) :
+  sineAmplitudes(6*numRobots, 0),
+  sineFrequencies(6*numRobots, 0),
+  sinePhaseOffsets(6*numRobots, 0),
+  sineLegOffsets(6*numRobots, 0),
+  targetPos(6*numRobots, 0),
+  targetVel(6*numRobots, 0),
+  N(numRobots),
+  foreAngle(0),
+  aftAngle(M_PI),
+  linearizationFactor(defaultLinerizationFactor),
+  hoverSlewRate(0.01),
+  hoverParkAngle(defaultHoverParkAngleRad),
+  hoverIIRValue(exp(-0.001/UnderwaterSwimmerGait::saturate(defaultHoverIIRTimeConstant, 0.001, 1))),
+  hoverKneePoint(M_PI/4),
+  legsEnabled(numRobots, false),
+  swimBackwards(numRobots, false),
+  speedCmd(numRobots, 0),
+  hoverPitchCommand(numRobots, 0),
+  hoverRollCommand(numRobots, 0),
+  hoverYawCommand(numRobots, 0),
+  hoverHeaveCommand(numRobots, 0),
+  maxAmplitudeRad(numRobots, defaultMaxAmplitudeRad),
+  frequencyHz(numRobots, defaultFrequency),
+  latestUpdateSineCmdTime(numRobots, -1),
+  FSLatestUpdateMotorTargetsTime(numRobots, -1),
+  leg_offset(6*numRobots, 0),
+  desired_leg_offset(6*numRobots, 0),
+  phase_offset(6*numRobots, 0),
+  hover_offset(6*numRobots, 0),
+  hoverAmp(6*numRobots, 0),
+  FStsinstart(6*numRobots, 0),
+  FSLatestPos(6*numRobots, 0),
+  FSLatestVel(6*numRobots, 0),
+  currAmplitudes(6*numRobots, 0),
+  currFrequencies(6*numRobots, defaultFrequency),
+  currPhaseOffsets(6*numRobots, 0),
+  currLegOffsets(6*numRobots, 0),
+  currLegVelocities(6*numRobots, 0),
+  tgtAmplitudes(6*numRobots, 0),
+  tgtFrequencies(6*numRobots, defaultFrequency),
+  tgtPhaseOffsets(6*numRobots, 0),
+  tgtLegOffsets(6*numRobots, 0),
+  tgtLegVelocities(6*numRobots, 0),
+  scratchSlewRate(numRobots, 0),
+  scratchDt(numRobots, 0),
+  scratchSpeed(numRobots, 0),
+  scratchAcc(numRobots, 0),
+  scratchDownscale(numRobots, 0),
+  scratchLegAcc(6*numRobots, 0),
+  scratchMSEC(numRobots, 0),
+  scratchUseEmpirical(6*numRobots, false) {
+  // default phase offsets for the hover-midoff gait
+  for (size_t r = 0; r < N; r++) {
+    for (int i = 1; i < 6; i += 3) {
+      phase_offset[idx(i, r)] = currPhaseOffsets[idx(i, r)] = tgtPhaseOffsets[idx(i, r)] = M_PI;
+    }
+  }
+};
+
+
+void UnderwaterSwimmerGaitBatch::activate(double now) {
+  for (size_t r = 0; r < N; r++) {
+    activate(r, now);
+  }
+};
+
+
+void UnderwaterSwimmerGaitBatch::activate(size_t r, double now) {
+  speedCmd[r] = 0;
+  hoverPitchCommand[r] = 0;
+  hoverRollCommand[r] = 0;
+  hoverYawCommand[r] = 0;
+  hoverHeaveCommand[r] = 0;
+  latestUpdateSineCmdTime[r] = -1;
+  FSLatestUpdateMotorTargetsTime[r] = -1;
+
+  for (int i = 0; i < 6; i++) {
+    size_t k = idx(i, r);
+    hoverAmp[k] = 0.0;
+    hover_offset[k] = 0.0;
+    leg_offset[k] = desired_leg_offset[k] = 0.0;
+    FStsinstart[k] = now;
+
+    phase_offset[k] = ((i == 1) || (i == 4)) ? M_PI : 0.0;
+    currPhaseOffsets[k] = tgtPhaseOffsets[k] = phase_offset[k];
+  }
+
+  legsEnabled[r] = true;
+};
+
+
+void UnderwaterSwimmerGaitBatch::setBodyCmd(size_t r, float speed, float heave, float roll, float pitch, float yaw) {
+  speedCmd[r] = UnderwaterSwimmerGait::saturate(speed, 0.0, 1.0);
+  hoverHeaveCommand[r] = UnderwaterSwimmerGait::saturate(heave, -1.0, 1.0);
+  hoverRollCommand[r] = UnderwaterSwimmerGait::saturate(roll, -1.0, 1.0);
+  hoverPitchCommand[r] = UnderwaterSwimmerGait::saturate(pitch, -1.0, 1.0);
+  hoverYawCommand[r] = UnderwaterSwimmerGait::saturate(yaw, -1.0, 1.0);
+};
+
+
+void UnderwaterSwimmerGaitBatch::foreaftControl(size_t r, int direction) {
+  bool newSwimBackwards = (direction < 0);
+  if ((bool)swimBackwards[r] != newSwimBackwards) {
+    swimBackwards[r] = newSwimBackwards;
+    for (int i = 0; i < 6; i++) { hover_offset[idx(i, r)] = -hover_offset[idx(i, r)]; }
+  }
+};
+
+
+void UnderwaterSwimmerGaitBatch::setPeriodicLegCmd(size_t r, const PeriodicLegState_t& legsCmd) {
+  for (int i = 0; i < 6; i++) {
+    size_t k = idx(i, r);
+    tgtFrequencies[k] = UnderwaterSwimmerGait::saturate(legsCmd.frequencies[i], 0.0, UnderwaterSwimmerGait::FS_MAX_FREQUENCY_HZ);
+    tgtAmplitudes[k] = UnderwaterSwimmerGait::saturate(legsCmd.amplitudes[i], 0, M_PI/2);
+    if (!UnderwaterSwimmerGait::FS_PHASE_OFFSET_USE_STATIC) {
+      tgtPhaseOffsets[k] = UnderwaterSwimmerGait::FSPiAdjust(legsCmd.phase_offsets[i]);
+    }
+    tgtLegOffsets[k] = UnderwaterSwimmerGait::FSPiAdjust(legsCmd.leg_offsets[i]);
+    tgtLegVelocities[k] = UnderwaterSwimmerGait::saturate(legsCmd.leg_velocities[i], -4*M_PI, 4*M_PI);
+  }
+};
+
+
+void UnderwaterSwimmerGaitBatch::updateSineCmd(double now, size_t begin, size_t end) {
+  // Per-robot time since last call; robots with disabled legs keep their state
+  for (size_t r = begin; r < end; r++) {
+    double dt = 0;
+    if (legsEnabled[r] && latestUpdateSineCmdTime[r] >= 0) {
+      dt = now - latestUpdateSineCmdTime[r];
+    }
+    if (legsEnabled[r]) {
+      latestUpdateSineCmdTime[r] = now;
+    }
+    scratchDt[r] = dt;
+    scratchMSEC[r] = (dt > 0) ? (unsigned int)batchFloor(dt/0.001) : 0;
+    scratchSlewRate[r] = hoverSlewRate * dt * 1.0e3;
+  }
+
+  for (int i = 0; i < 6; i++) {
+    const float fore = foreAngle, aft = aftAngle;
+    for (size_t r = begin; r < end; r++) {
+      size_t k = idx(i, r);
+      const bool active = scratchDt[r] > 0;
+      const float d = swimBackwards[r] ? -1 : 1;
+
+      // Thruster direction for this leg (see ComputeOrientedThruster)
+      float Xthrust = rollSign[i]*hoverRollCommand[r] + pitchSign[i]*hoverPitchCommand[r] + d*hoverHeaveCommand[r];
+      float Ythrust = d*yawSign[i]*hoverYawCommand[r] + speedCmd[r];
+      float nonSaturatedMagThrust = sqrt(Xthrust*Xthrust + Ythrust*Ythrust);
+      Xthrust = UnderwaterSwimmerGait::saturate(Xthrust, -1.5, 1.5);
+      Ythrust = UnderwaterSwimmerGait::saturate(Ythrust, 0.0, 1.0);
+      float targetAngle = atan2(Xthrust, Ythrust);
+      float Magthrust = sqrt(Xthrust*Xthrust + Ythrust*Ythrust);
+      Magthrust = UnderwaterSwimmerGait::saturate(Magthrust, 0.0, 1.5);
+
+      float legAngle = hover_offset[k];
+      float slewRate = scratchSlewRate[r];
+      const bool park = Magthrust < 0.05;
+      const bool retract = nonSaturatedMagThrust > 0.1;
+      float parkedAngle = UnderwaterSwimmerGait::saturate(legAngle, -hoverParkAngle, hoverParkAngle);
+      targetAngle = park ? (retract ? 0.0f : parkedAngle) : targetAngle;
+      float parkSlewRate = slewRate*(retract ? 0.2 : 0.05);
+      float thrustSlewRate = slewRate * Magthrust;
+      slewRate = park ? parkSlewRate : thrustSlewRate;
+
+      float deltaAngle = targetAngle - legAngle;
+      float ratio = UnderwaterSwimmerGait::saturate((1 - fabs(deltaAngle) / (hoverKneePoint)), 0.0, 1.0);
+      float targetAmp = Magthrust * ratio;
+      float newHoverOffset = legAngle + UnderwaterSwimmerGait::saturate(deltaAngle, -slewRate, slewRate);
+      targetAmp *= maxAmplitudeRad[r];
+      float newHoverAmp = batchIIR(hoverAmp[k], targetAmp, hoverIIRValue, scratchMSEC[r]);
+
+      // Filter leg offset angle
+      bool flattenFlippers = false;
+#ifdef FLATTEN_FLIPPERS_ON_ZERO_BODY_COMMAND
+      flattenFlippers = (speedCmd[r] == 0 && hoverHeaveCommand[r] == 0 && hoverRollCommand[r] == 0 &&
+                         hoverPitchCommand[r] == 0 && hoverYawCommand[r] == 0);
+#endif
+      float newDesired = flattenFlippers ? 0.0f : newHoverOffset + (swimBackwards[r] ? aft : fore);
+      float newLegOffset = leg_offset[k];
+      if (linearizationFactor > 0.001) {
+        newLegOffset = FSRateLinearizedIIR(newLegOffset, newDesired, hoverIIRValue,
+            linearizationFactor, scratchMSEC[r]);
+      } else {
+        newLegOffset = batchIIR(newLegOffset, newDesired, hoverIIRValue, scratchMSEC[r]);
+      }
+      newLegOffset = batchPiAdjust(newLegOffset);
+
+      hover_offset[k] = active ? newHoverOffset : hover_offset[k];
+      hoverAmp[k] = active ? newHoverAmp : hoverAmp[k];
+      desired_leg_offset[k] = active ? newDesired : desired_leg_offset[k];
+      leg_offset[k] = active ? newLegOffset : leg_offset[k];
+
+      // Store resulting commands
+      const bool enabled = legsEnabled[r];
+      sineAmplitudes[k] = enabled ? hoverAmp[k] : 0.0f;
+      sineFrequencies[k] = enabled ? frequencyHz[r] : 0.0f;
+      sinePhaseOffsets[k] = phase_offset[k];
+      sineLegOffsets[k] = leg_offset[k];
+    }
+  }
+};
+
+
+void UnderwaterSwimmerGaitBatch::updateMotorTarget(double now, size_t begin, size_t end) {
+  const double two_pi = UnderwaterSwimmerGait::two_pi;
+
+  // 0. Determine time since last call; robots with dt <= 0 keep their state
+  for (size_t r = begin; r < end; r++) {
+    double dt = 0;
+    if (legsEnabled[r] && FSLatestUpdateMotorTargetsTime[r] >= 0) {
+      dt = now - FSLatestUpdateMotorTargetsTime[r];
+    }
+    if (legsEnabled[r]) {
+      FSLatestUpdateMotorTargetsTime[r] = now;
+    }
+    scratchDt[r] = dt;
+    scratchSpeed[r] = 0;
+    scratchAcc[r] = 0;
+  }
+
+  // 1. Update current leg commands with target commands, 2. compute sinusoidal motion
+  //    and 3.1 switch to empirical velocity during transients
+  for (int i = 0; i < 6; i++) {
+    for (size_t r = begin; r < end; r++) {
+      size_t k = idx(i, r);
+      const double dt = scratchDt[r];
+      const bool active = dt > 0;
+
+      float legVelocity = tgtLegVelocities[k];
+      float phaseOffset = UnderwaterSwimmerGait::FS_PHASE_OFFSET_USE_STATIC ? currPhaseOffsets[k] : tgtPhaseOffsets[k];
+      float amplitude = tgtAmplitudes[k];
+      float frequency = tgtFrequencies[k];
+      float legOffset = currLegOffsets[k];
+      legOffset = (legVelocity != 0) ? (float)(legOffset + legVelocity*dt) : tgtLegOffsets[k];
+
+      double tsin = now - FStsinstart[k];
+      const float omega = two_pi*frequency;
+      double currPhase = omega * tsin + phaseOffset;
+      double pos = legOffset, vel = 0;
+      if (omega != 0) {
+        pos = amplitude * std::cos(currPhase) + legOffset;
+        vel = -amplitude * omega * std::sin(currPhase);
+      }
+
+      // end of a sine period (rare, so the floor is only evaluated then)
+      double currPeriod = 1.0/frequency;
+      double tsinstart = FStsinstart[k];
+      if (omega == 0) {
+        tsinstart = now;
+      } else if (tsin > currPeriod) {
+        tsinstart = now - (tsin - floor(tsin/currPeriod)*currPeriod);
+      }
+
+      // robots whose time did not progress have dt == 0; their outputs are discarded in 3.4
+      double velEmp = active ? batchAngularMag(pos, FSLatestPos[k])/dt : 0.0;
+      bool useEmpirical = (fabs(velEmp) > fabs(vel)) || (sign(velEmp) != sign(vel));
+      vel = useEmpirical ? velEmp : vel;
+
+      currLegVelocities[k] = active ? legVelocity : currLegVelocities[k];
+      currPhaseOffsets[k] = active ? phaseOffset : currPhaseOffsets[k];
+      currAmplitudes[k] = active ? amplitude : currAmplitudes[k];
+      currFrequencies[k] = active ? frequency : currFrequencies[k];
+      currLegOffsets[k] = active ? legOffset : currLegOffsets[k];
+      FStsinstart[k] = active ? tsinstart : FStsinstart[k];
+
+      targetPos[k] = pos;
+      targetVel[k] = vel;
+      scratchUseEmpirical[k] = useEmpirical;
+      scratchSpeed[r] += active ? fabs(vel) : 0.0;
+    }
+  }
+
+  // 3.2 Limit maximum velocity via saturation or sigmoid squashing
+  for (size_t r = begin; r < end; r++) {
+    double velDownscaleFactor = 1.0;
+    if (UnderwaterSwimmerGait::FS_ALL_MOTORS_VELOCITY_MAX >= 0) {
+      if (UnderwaterSwimmerGait::FS_ALL_MOTORS_VELOCITY_SQUASH_MAX) {
+        velDownscaleFactor = UnderwaterSwimmerGait::FSSigmoidSquashGain(scratchSpeed[r],
+            UnderwaterSwimmerGait::FS_ALL_MOTORS_VELOCITY_MAX,
+            UnderwaterSwimmerGait::FS_ALL_MOTORS_VELOCITY_SQUASH_GAIN);
+      } else if (scratchSpeed[r] > UnderwaterSwimmerGait::FS_ALL_MOTORS_VELOCITY_MAX) {
+        velDownscaleFactor = UnderwaterSwimmerGait::FS_ALL_MOTORS_VELOCITY_MAX / scratchSpeed[r];
+      }
+    }
+    scratchDownscale[r] = velDownscaleFactor;
+  }
+  for (int i = 0; i < 6; i++) {
+    for (size_t r = begin; r < end; r++) {
+      size_t k = idx(i, r);
+      if (UnderwaterSwimmerGait::FS_ALL_MOTORS_VELOCITY_MAX >= 0) {
+        targetVel[k] *= scratchDownscale[r];
+      }
+      const double dt = scratchDt[r];
+      scratchLegAcc[k] = (dt > 0) ? (targetVel[k] - FSLatestVel[k])/dt : 0.0;
+      scratchAcc[r] += fabs(scratchLegAcc[k]);
+    }
+  }
+
+  // 3.3 Limit maximum acceleration via saturation or sigmoid squashing
+  for (size_t r = begin; r < end; r++) {
+    double accDownscaleFactor = 1.0;
+    if (UnderwaterSwimmerGait::FS_ALL_MOTORS_ACCELERATION_MAX >= 0) {
+      if (UnderwaterSwimmerGait::FS_ALL_MOTORS_ACCELERATION_SQUASH_MAX) {
+        accDownscaleFactor = UnderwaterSwimmerGait::FSSigmoidSquashGain(scratchAcc[r],
+            UnderwaterSwimmerGait::FS_ALL_MOTORS_ACCELERATION_MAX,
+            UnderwaterSwimmerGait::FS_ALL_MOTORS_ACCELERATION_SQUASH_GAIN);
+      } else if (scratchAcc[r] > UnderwaterSwimmerGait::FS_ALL_MOTORS_ACCELERATION_MAX) {
+        accDownscaleFactor = UnderwaterSwimmerGait::FS_ALL_MOTORS_ACCELERATION_MAX/scratchAcc[r];
+      }
+    }
+    scratchDownscale[r] = accDownscaleFactor;
+  }
+
+  // 3.4 Filter change in target position, and 4. save filtered motor targets
+  for (int i = 0; i < 6; i++) {
+    for (size_t r = begin; r < end; r++) {
+      size_t k = idx(i, r);
+      const double dt = scratchDt[r];
+      const double accDownscaleFactor = scratchDownscale[r];
+      double acc = scratchLegAcc[k] * accDownscaleFactor;
+      double vel = FSLatestVel[k] + acc*dt;
+      double pos = (scratchUseEmpirical[k] || accDownscaleFactor < 1) ? FSLatestPos[k] + vel*dt : targetPos[k];
+
+      // robots with disabled legs go to their current leg offset; robots whose time did not
+      // progress repeat their latest targets
+      const bool enabled = legsEnabled[r];
+      const bool active = dt > 0;
+      pos = enabled ? (active ? pos : FSLatestPos[k]) : currLegOffsets[k];
+      vel = enabled ? (active ? vel : FSLatestVel[k]) : 0.0;
+      targetPos[k] = FSLatestPos[k] = pos;
+      targetVel[k] = FSLatestVel[k] = vel;
+    }
+  }
+};
+
+
+void UnderwaterSwimmerGaitBatch::getSineCmd(size_t r, PeriodicLegState_t& legsCmd) const {
+  for (int i = 0; i < 6; i++) {
+    size_t k = idx(i, r);
+    legsCmd.amplitudes[i] = sineAmplitudes[k];
+    legsCmd.frequencies[i] = sineFrequencies[k];
+    legsCmd.phase_offsets[i] = sinePhaseOffsets[k];
+    legsCmd.leg_offsets[i] = sineLegOffsets[k];
+    legsCmd.leg_velocities[i] = 0;
+  }
+};
+
+
+void UnderwaterSwimmerGaitBatch::getMotorTarget(size_t r, MotorTarget_t (&target)[6]) const {
+  for (int i = 0; i < 6; i++) {
+    size_t k = idx(i, r);
+    target[i].pos = targetPos[k];
+    target[i].vel = targetVel[k];
+    target[i].acc = 0;
+  }
+};
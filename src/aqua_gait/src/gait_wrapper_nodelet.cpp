@@ -0,0 +1,69 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "aqua_gait/GaitWrapper.hpp"
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <boost/shared_ptr.hpp>
+
+
+namespace aqua_gait {
+
+
+/**
+ * GaitWrapper (hover_midoff_node) as a nodelet. The 1/spin_rate refresh of
+ * GaitWrapper::spin() is driven by a wall timer on the nodelet's queue, which
+ * also runs the subscription callbacks, so they never run concurrently.
+ */
+class GaitWrapperNodelet : public nodelet::Nodelet {
+private:
+  virtual void onInit() {
+    wrapper.reset(new GaitWrapper(getNodeHandle(), getPrivateNodeHandle(), true));
+    refresh_timer = getNodeHandle().createWallTimer(ros::WallDuration(1.0/wrapper->getSpinRate()),
+        &GaitWrapperNodelet::refresh, this);
+  };
+
+
+  void refresh(const ros::WallTimerEvent& e) {
+    wrapper->refresh();
+  };
+
+
+  boost::shared_ptr<GaitWrapper> wrapper;
+  ros::WallTimer refresh_timer;
+};
+
+
+} // namespace aqua_gait
+
+
+PLUGINLIB_EXPORT_CLASS(aqua_gait::GaitWrapperNodelet, nodelet::Nodelet)
@@ -0,0 +1,421 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+/**
+ * gaits_bench: non-interactive microbenchmarks for the gait hot paths.
+ *
+ * Every benchmark drives a command profile under a simulated 1 kHz clock, so
+ * results do not depend on wall-clock scheduling of the control loop itself.
+ * Each benchmark is repeated several times and reports ns/update statistics
+ * over the repetitions, plus retired instructions/update when the kernel
+ * grants access to hardware counters (null otherwise). Results are written as
+ * JSON so that gait changes can be gated on performance regressions.
+ *
+ * Command profiles (-p):
+ * - steps: random body commands held for 500 ms (default)
+ * - sweep: slowly varying sinusoidal body commands
+ * - stall: steps, with a 20-80 ms clock jump every 2 s (catch-up paths)
+ * - <file>: recorded commands, one "t speed heave roll pitch yaw" row per line
+ *   (whitespace or comma separated, t in seconds and non-decreasing)
+ *
+ * usage: rosrun aqua_gait gaits_bench [-p profile] [-n updates] [-r repetitions] [-b batch_robots] [-o output.json]
+ */
+
+#include "aqua_gait/Gaits.hpp"
+#include "aqua_gait/GaitsCommon.hpp"
+#include "aqua_gait/GaitBatch.hpp"
+
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+
+struct BodyCmd_t {
+  double t;
+  float speed, heave, roll, pitch, yaw;
+};
+
+
+struct BenchResult_t {
+  std::string name;
+  size_t updates;
+  std::vector<double> nsPerUpdate;
+  std::vector<double> instructionsPerUpdate; // empty if counters are unavailable
+};
+
+
+// Sink for benchmark outputs, so that the compiler cannot drop the timed work
+static volatile double benchSink = 0;
+
+
+/** Retired-instruction counter for the calling thread; valid() is false if perf is unavailable */
+class InstructionCounter {
+public:
+  InstructionCounter() : fd(-1) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+  };
+  ~InstructionCounter() { if (fd >= 0) close(fd); };
+
+  bool valid() const { return fd >= 0; };
+
+  void start() {
+#ifdef __linux__
+    if (fd < 0) return;
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+  };
+
+  long long stop() {
+    long long count = -1;
+#ifdef __linux__
+    if (fd < 0) return -1;
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &count, sizeof(count)) != sizeof(count)) count = -1;
+#endif
+    return count;
+  };
+
+private:
+  int fd;
+};
+
+
+/** Body command at simulated time t (profiles are sorted by time) */
+class CommandProfile {
+public:
+  explicit CommandProfile(const std::vector<BodyCmd_t>& cmds) : cmds(cmds), next(0) {};
+
+  void rewind() { next = 0; };
+
+  // Returns true and sets cmd if a new command became active at or before t
+  bool poll(double t, BodyCmd_t& cmd) {
+    bool changed = false;
+    while (next < cmds.size() && cmds[next].t <= t) {
+      cmd = cmds[next++];
+      changed = true;
+    }
+    return changed;
+  };
+
+private:
+  const std::vector<BodyCmd_t>& cmds;
+  size_t next;
+};
+
+
+std::vector<BodyCmd_t> makeSyntheticProfile(const std::string& kind, double duration) {
+  std::vector<BodyCmd_t> cmds;
+  std::mt19937 gen(765);
+  std::uniform_real_distribution<float> U(-1, 1);
+  if (kind == "sweep") {
+    for (double t = 0; t < duration; t += 0.01) {
+      BodyCmd_t c = {t, (float) (0.5 + 0.5*sin(0.3*t)), (float) sin(0.7*t), (float) sin(1.1*t),
+          (float) sin(0.5*t + 1), (float) sin(0.9*t + 2)};
+      cmds.push_back(c);
+    }
+  } else { // steps, stall
+    for (double t = 0; t < duration; t += 0.5) {
+      BodyCmd_t c = {t, (U(gen) + 1)/2, U(gen), U(gen), U(gen), U(gen)};
+      cmds.push_back(c);
+    }
+  }
+  return cmds;
+};
+
+
+bool loadRecordedProfile(const std::string& path, std::vector<BodyCmd_t>& cmds) {
+  FILE* f = fopen(path.c_str(), "r");
+  if (!f) return false;
+  char line[512];
+  while (fgets(line, sizeof(line), f)) {
+    for (char* p = line; *p; p++) if (*p == ',') *p = ' ';
+    BodyCmd_t c;
+    if (sscanf(line, "%lf %f %f %f %f %f", &c.t, &c.speed, &c.heave, &c.roll, &c.pitch, &c.yaw) == 6) {
+      cmds.push_back(c);
+    }
+  }
+  fclose(f);
+  if (!cmds.empty()) {
+    double t0 = cmds.front().t;
+    for (BodyCmd_t& c : cmds) c.t -= t0;
+  }
+  return !cmds.empty();
+};
+
+
+/** Simulated clock samples: 1 ms ticks, with occasional jumps for the 'stall' profile */
+std::vector<double> makeClock(size_t updates, bool stalls) {
+  std::vector<double> clock(updates);
+  std::mt19937 gen(2019);
+  std::uniform_int_distribution<int> stallMs(20, 80);
+  double t = 1.0;
+  for (size_t k = 0; k < updates; k++) {
+    t += (stalls && k > 0 && k % 2000 == 0) ? 0.001*stallMs(gen) : 0.001;
+    clock[k] = t;
+  }
+  return clock;
+};
+
+
+/**
+ * Runs body() 'repetitions' times and records the per-update cost; setup() is
+ * called before each repetition and excluded from the measurement.
+ */
+BenchResult_t runBench(const std::string& name, size_t updates, int repetitions,
+    InstructionCounter& counter, std::function<void(void)> setup, std::function<void(void)> body) {
+  BenchResult_t res;
+  res.name = name;
+  res.updates = updates;
+  for (int rep = 0; rep < repetitions + 1; rep++) {
+    setup();
+    counter.start();
+    auto t0 = std::chrono::steady_clock::now();
+    body();
+    auto t1 = std::chrono::steady_clock::now();
+    long long instructions = counter.stop();
+    if (rep == 0) continue; // warm-up
+    res.nsPerUpdate.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count() / updates);
+    if (instructions >= 0) res.instructionsPerUpdate.push_back(double(instructions) / updates);
+  }
+  fprintf(stderr, "%-32s %10.1f ns/update\n", name.c_str(),
+      *std::min_element(res.nsPerUpdate.begin(), res.nsPerUpdate.end()));
+  return res;
+};
+
+
+void writeStats(FILE* out, const char* key, std::vector<double> v) {
+  if (v.empty()) {
+    fprintf(out, "\"%s\": null", key);
+    return;
+  }
+  double mean = 0, var = 0;
+  for (double x : v) mean += x;
+  mean /= v.size();
+  for (double x : v) var += (x - mean)*(x - mean);
+  var = (v.size() > 1) ? var/(v.size() - 1) : 0;
+  std::sort(v.begin(), v.end());
+  fprintf(out, "\"%s\": {\"mean\": %.3f, \"variance\": %.3f, \"min\": %.3f, \"median\": %.3f, \"max\": %.3f}",
+      key, mean, var, v.front(), v[v.size()/2], v.back());
+};
+
+
+int main(int argc, char** argv) {
+  std::string profileName = "steps";
+  std::string outputPath;
+  size_t updates = 20000;
+  int repetitions = 10;
+  size_t batchRobots = 64;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "p:n:r:b:o:")) != -1) {
+    switch (opt) {
+      case 'p': profileName = optarg; break;
+      case 'n': updates = std::max(1L, atol(optarg)); break;
+      case 'r': repetitions = std::max(1, atoi(optarg)); break;
+      case 'b': batchRobots = std::max(1L, atol(optarg)); break;
+      case 'o': outputPath = optarg; break;
+      default:
+        fprintf(stderr, "usage: %s [-p steps|sweep|stall|FILE] [-n updates] [-r repetitions] [-b batch_robots] [-o output.json]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  std::vector<BodyCmd_t> cmds;
+  if (profileName == "steps" || profileName == "sweep" || profileName == "stall") {
+    cmds = makeSyntheticProfile(profileName, updates*0.001 + 10);
+  } else if (!loadRecordedProfile(profileName, cmds)) {
+    fprintf(stderr, "could not read command profile %s\n", profileName.c_str());
+    return 1;
+  }
+  const std::vector<double> clock = makeClock(updates, profileName == "stall");
+  const double t0 = clock.front() - 0.001;
+
+  // Reference sine commands, so that updateMotorTarget() can be measured on its own
+  std::vector<PeriodicLegState_t> sineCmds(updates);
+  {
+    UnderwaterSwimmerGait gait;
+    CommandProfile profile(cmds);
+    BodyCmd_t cmd;
+    gait.activate(t0);
+    for (size_t k = 0; k < updates; k++) {
+      if (profile.poll(clock[k] - t0, cmd)) gait.setBodyCmd(cmd.speed, cmd.heave, cmd.roll, cmd.pitch, cmd.yaw);
+      gait.updateSineCmd(clock[k], sineCmds[k]);
+    }
+  }
+
+  InstructionCounter counter;
+  std::vector<BenchResult_t> results;
+
+  {
+    UnderwaterSwimmerGait gait;
+    CommandProfile profile(cmds);
+    PeriodicLegState_t plc;
+    results.push_back(runBench("updateSineCmd", updates, repetitions, counter,
+        [&]() { gait.activate(t0); profile.rewind(); },
+        [&]() {
+          BodyCmd_t cmd;
+          for (size_t k = 0; k < updates; k++) {
+            if (profile.poll(clock[k] - t0, cmd)) gait.setBodyCmd(cmd.speed, cmd.heave, cmd.roll, cmd.pitch, cmd.yaw);
+            gait.updateSineCmd(clock[k], plc);
+          }
+          benchSink = benchSink + plc.leg_offsets[0];
+        }));
+  }
+
+  const GaitMathBackend backends[2] = {GAIT_MATH_LIBM, GAIT_MATH_FAST};
+  const char* backendNames[2] = {"updateMotorTarget", "updateMotorTarget_fast"};
+  std::vector<MotorTarget_t> targets[2];
+  for (int b = 0; b < 2; b++) {
+    UnderwaterSwimmerGait gait(nullptr, 20.0/180.0*M_PI, 2.5, M_PI/4, 0.03, 0.0, backends[b]);
+    std::vector<MotorTarget_t>& out = targets[b];
+    out.resize(6*updates);
+    results.push_back(runBench(backendNames[b], updates, repetitions, counter,
+        [&]() { gait.activate(t0); },
+        [&]() {
+          for (size_t k = 0; k < updates; k++) {
+            gait.setPeriodicLegCmd(sineCmds[k]);
+            gait.updateMotorTarget(clock[k], *reinterpret_cast<MotorTarget_t (*)[6]>(&out[6*k]));
+          }
+        }));
+  }
+  double fastMaxAbsDiff = 0;
+  for (size_t k = 0; k < 6*updates; k++) {
+    fastMaxAbsDiff = std::max(fastMaxAbsDiff, fabs(targets[0][k].pos - targets[1][k].pos));
+    fastMaxAbsDiff = std::max(fastMaxAbsDiff, fabs(targets[0][k].vel - targets[1][k].vel));
+  }
+
+  {
+    std::vector<float> thrust(2*updates), hoverOffset(updates), amp(updates);
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> U(-1.5, 1.5);
+    for (float& x : thrust) x = U(gen);
+    results.push_back(runBench("ComputeOrientedThruster", updates, repetitions, counter,
+        [&]() { std::fill(hoverOffset.begin(), hoverOffset.end(), 0.0f); },
+        [&]() {
+          float legAngle = 0;
+          for (size_t k = 0; k < updates; k++) {
+            ComputeOrientedThruster(thrust[2*k], thrust[2*k + 1], 0.0, &legAngle, &amp[k],
+                0.01, M_PI/4, M_PI/4);
+            hoverOffset[k] = legAngle;
+          }
+          benchSink = benchSink + legAngle;
+        }));
+  }
+
+  {
+    std::vector<float> in(updates);
+    std::vector<unsigned int> ms(updates);
+    std::mt19937 gen(43);
+    std::uniform_real_distribution<float> U(-M_PI, M_PI);
+    for (size_t k = 0; k < updates; k++) {
+      in[k] = U(gen);
+      ms[k] = (k % 100 == 0) ? 50 : 1;
+    }
+    const float gain = exp(-0.001/0.03);
+    results.push_back(runBench("FSIIR", updates, repetitions, counter,
+        []() {},
+        [&]() {
+          float v = 0;
+          for (size_t k = 0; k < updates; k++) {
+            v = FSIIR(v, in[k], gain, ms[k]);
+          }
+          benchSink = benchSink + v;
+        }));
+  }
+
+  {
+    UnderwaterSwimmerGaitBatch batch(batchRobots);
+    CommandProfile profile(cmds);
+    size_t batchUpdates = std::max<size_t>(1, updates/batchRobots);
+    BenchResult_t res = runBench("UnderwaterSwimmerGaitBatch", batchUpdates*batchRobots, repetitions, counter,
+        [&]() { batch.activate(t0); profile.rewind(); },
+        [&]() {
+          BodyCmd_t cmd;
+          for (size_t k = 0; k < batchUpdates; k++) {
+            if (profile.poll(clock[k] - t0, cmd)) {
+              for (size_t r = 0; r < batchRobots; r++) batch.setBodyCmd(r, cmd.speed, cmd.heave, cmd.roll, cmd.pitch, cmd.yaw);
+            }
+            batch.updateSineCmd(clock[k]);
+            batch.updateMotorTarget(clock[k]);
+          }
+        });
+    results.push_back(res);
+  }
+
+  FILE* out = stdout;
+  if (!outputPath.empty()) {
+    out = fopen(outputPath.c_str(), "w");
+    if (!out) {
+      fprintf(stderr, "could not open %s for writing\n", outputPath.c_str());
+      return 1;
+    }
+  }
+  fprintf(out, "{\n  \"profile\": \"%s\",\n  \"updates\": %zu,\n  \"repetitions\": %d,\n", profileName.c_str(), updates, repetitions);
+  fprintf(out, "  \"instruction_counters\": %s,\n", counter.valid() ? "true" : "false");
+  fprintf(out, "  \"fast_math_max_abs_diff\": %.3e,\n", fastMaxAbsDiff);
+  fprintf(out, "  \"benchmarks\": [\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    fprintf(out, "    {\"name\": \"%s\", \"updates\": %zu, ", results[i].name.c_str(), results[i].updates);
+    writeStats(out, "ns_per_update", results[i].nsPerUpdate);
+    fprintf(out, ", ");
+    writeStats(out, "instructions_per_update", results[i].instructionsPerUpdate);
+    fprintf(out, "}%s\n", (i + 1 < results.size()) ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+  if (out != stdout) fclose(out);
+
+  return 0;
+};
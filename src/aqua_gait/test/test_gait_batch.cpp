@@ -0,0 +1,130 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <gtest/gtest.h>
+#include "aqua_gait/Gaits.hpp"
+#include "aqua_gait/GaitBatch.hpp"
+#include <cmath>
+#include <random>
+#include <vector>
+
+
+// Drives a batch and one UnderwaterSwimmerGait per robot with the same command
+// stream at 1 kHz, and checks that every robot's motor targets match its scalar twin.
+// Both keep the hover state in floats, so the tolerances allow for single-precision
+// rounding differences when GaitBatch.cpp is built with other flags (e.g. FMA)
+class GaitBatchTest : public ::testing::Test {
+protected:
+  static const size_t N = 8;
+
+  GaitBatchTest() : batch(N), gaits(N), gen(34), U(-1, 1), t(1.0) {};
+
+  void setBodyCmd(size_t r) {
+    float speed = (U(gen) + 1)/2, heave = U(gen), roll = U(gen), pitch = U(gen), yaw = U(gen);
+    batch.setBodyCmd(r, speed, heave, roll, pitch, yaw);
+    gaits[r].setBodyCmd(speed, heave, roll, pitch, yaw);
+  };
+
+  void foreaftControl(size_t r, int direction) {
+    batch.foreaftControl(r, direction);
+    gaits[r].foreaftControl(direction);
+  };
+
+  // Runs one update of both implementations at time now, and compares their outputs
+  void update(double now) {
+    batch.updateSineCmd(now);
+    for (size_t r = 0; r < N; r++) {
+      PeriodicLegState_t plc;
+      gaits[r].updateSineCmd(now, plc);
+      gaits[r].setPeriodicLegCmd(plc);
+      batch.getSineCmd(r, plc);
+      batch.setPeriodicLegCmd(r, plc);
+    }
+    batch.updateMotorTarget(now);
+    for (size_t r = 0; r < N; r++) {
+      MotorTarget_t expected[6], actual[6];
+      gaits[r].updateMotorTarget(now, expected);
+      batch.getMotorTarget(r, actual);
+      for (int i = 0; i < 6; i++) {
+        ASSERT_TRUE(std::isfinite(actual[i].pos) && std::isfinite(actual[i].vel)) << "robot " << r << " leg " << i;
+        ASSERT_NEAR(expected[i].pos, actual[i].pos, 1e-5) << "robot " << r << " leg " << i << " at t=" << now;
+        ASSERT_NEAR(expected[i].vel, actual[i].vel, 1e-2) << "robot " << r << " leg " << i << " at t=" << now;
+      }
+    }
+  };
+
+  UnderwaterSwimmerGaitBatch batch;
+  std::vector<UnderwaterSwimmerGait> gaits;
+  std::mt19937 gen;
+  std::uniform_real_distribution<float> U;
+  double t;
+};
+
+
+TEST_F(GaitBatchTest, matchesScalarGaits) {
+  // The last robot is never activated, so it must hold its leg offsets
+  for (size_t r = 0; r + 1 < N; r++) {
+    batch.activate(r, t);
+    gaits[r].activate(t);
+  }
+  for (int k = 0; k < 20000; k++) {
+    t += 0.001;
+    for (size_t r = 0; r < N; r++) {
+      if ((k + 97*r) % 500 == 0) setBodyCmd(r);
+    }
+    if (k == 5000) foreaftControl(1, -1);
+    if (k == 12000) foreaftControl(1, 1);
+    update(t);
+    if (::testing::Test::HasFatalFailure()) return;
+  }
+}
+
+
+TEST_F(GaitBatchTest, repeatedTimeKeepsTargets) {
+  for (size_t r = 0; r < N; r++) {
+    batch.activate(r, t);
+    gaits[r].activate(t);
+    setBodyCmd(r);
+  }
+  for (int k = 0; k < 2000; k++) {
+    // every other update repeats the previous time, so that dt == 0 for all robots
+    if (k % 2 == 0) t += 0.001;
+    update(t);
+    if (::testing::Test::HasFatalFailure()) return;
+  }
+}
+
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
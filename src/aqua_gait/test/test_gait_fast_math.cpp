@@ -0,0 +1,128 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <gtest/gtest.h>
+#include "aqua_gait/Gaits.hpp"
+#include "aqua_gait/GaitFastMath.hpp"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+
+// Checks the error bounds documented in GaitFastMath.hpp against libm
+
+
+TEST(GaitFastMath, sincos6WithinBound) {
+  std::mt19937_64 gen(37);
+  std::uniform_real_distribution<double> U(-1e5, 1e5);
+  double maxErr = 0;
+  for (int n = 0; n < 200000; n++) {
+    double x[6], s[6], c[6];
+    for (int i = 0; i < 6; i++) x[i] = (n % 2 == 0) ? U(gen) : U(gen)*1e-4; // also cover the gait phase range
+    GaitFastMath::sincos6(x, s, c);
+    for (int i = 0; i < 6; i++) {
+      maxErr = std::max(maxErr, std::fabs(s[i] - std::sin(x[i])));
+      maxErr = std::max(maxErr, std::fabs(c[i] - std::cos(x[i])));
+    }
+  }
+  EXPECT_LT(maxErr, 3e-16);
+}
+
+
+TEST(GaitFastMath, expWithinBound) {
+  std::mt19937_64 gen(38);
+  std::uniform_real_distribution<double> U(-708, 708);
+  double maxRelErr = 0;
+  for (int n = 0; n < 1000000; n++) {
+    double x = U(gen);
+    maxRelErr = std::max(maxRelErr, std::fabs(GaitFastMath::exp(x) - std::exp(x))/std::exp(x));
+  }
+  EXPECT_LT(maxRelErr, 1e-14);
+  EXPECT_EQ(GaitFastMath::exp(1000.0), GaitFastMath::exp(708.0));
+  EXPECT_GT(GaitFastMath::exp(-1000.0), 0.0);
+}
+
+
+TEST(GaitFastMath, sigmoidSquashGainWithinBound) {
+  typedef UnderwaterSwimmerGaitDefaultTraits Traits;
+  const double thresh = Traits::FS_ALL_MOTORS_VELOCITY_MAX;
+  const double gain = Traits::FS_ALL_MOTORS_VELOCITY_SQUASH_GAIN;
+  std::mt19937_64 gen(39);
+  std::uniform_real_distribution<double> logU(-6, 3);
+  double maxErr = 0;
+  for (int n = 0; n < 1000000; n++) {
+    double val = thresh*std::pow(10.0, logU(gen));
+    maxErr = std::max(maxErr, std::fabs(GaitFastMath::sigmoidSquashGain(val, thresh, gain) -
+        UnderwaterSwimmerGaitBase::FSSigmoidSquashGain(val, thresh, gain)));
+  }
+  EXPECT_LT(maxErr, 1e-11);
+  EXPECT_EQ(GaitFastMath::sigmoidSquashGain(0.0, thresh, gain), 0.0);
+}
+
+
+TEST(GaitFastMath, updateMotorTargetWithinBound) {
+  // Both backends track the same randomized sine commands at 1 kHz, with a
+  // command change every 500 ms so that the squashing paths are exercised too
+  UnderwaterSwimmerGait libm(nullptr, 20.0/180.0*M_PI, 2.5, M_PI/4, 0.03, 0.0, GAIT_MATH_LIBM);
+  UnderwaterSwimmerGait fast(nullptr, 20.0/180.0*M_PI, 2.5, M_PI/4, 0.03, 0.0, GAIT_MATH_FAST);
+  UnderwaterSwimmerGait sine;
+  std::mt19937 gen(40);
+  std::uniform_real_distribution<float> U(-1, 1);
+  double t = 1.0;
+  sine.activate(t);
+  libm.activate(t);
+  fast.activate(t);
+
+  PeriodicLegState_t plc;
+  MotorTarget_t libmTargets[6], fastTargets[6];
+  double maxErr = 0;
+  for (int k = 0; k < 60000; k++) {
+    t += 0.001;
+    if (k % 500 == 0) sine.setBodyCmd((U(gen) + 1)/2, U(gen), U(gen), U(gen), U(gen));
+    sine.updateSineCmd(t, plc);
+    libm.setPeriodicLegCmd(plc);
+    fast.setPeriodicLegCmd(plc);
+    libm.updateMotorTarget(t, libmTargets);
+    fast.updateMotorTarget(t, fastTargets);
+    for (int i = 0; i < 6; i++) {
+      maxErr = std::max(maxErr, std::fabs(libmTargets[i].pos - fastTargets[i].pos));
+      maxErr = std::max(maxErr, std::fabs(libmTargets[i].vel - fastTargets[i].vel));
+    }
+  }
+  EXPECT_LT(maxErr, 1e-11);
+}
+
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,80 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <gtest/gtest.h>
+#include "aqua_gait/GaitsCommon.hpp"
+#include <cmath>
+
+
+// Applies the one-msec filter step ms times, as the catch-up is meant to
+static float rateLinearizedIIRLoop(float old, float in, float gain, float alpha, unsigned int ms) {
+  for (unsigned int k = 0; k < ms; k++) {
+    old = FSRateLinearizedIIR(old, in, gain, alpha, 1);
+  }
+  return old;
+}
+
+
+// The catch-up follows the continuous-time filter, which differs from the discrete
+// steps by under 1% of the step size (most at small alpha, where e/alpha is large)
+TEST(FSRateLinearizedIIR, catchUpMatchesPerMsecLoop) {
+  const float gain = exp(-0.001/0.03);
+  const float alphas[] = {0.01, 0.1, 1.0};
+  const float steps[][2] = {{0, 1}, {1, 0}, {-0.5, 2.5}, {0.3, 0.3001}};
+  for (float alpha : alphas) {
+    for (const float (&step)[2] : steps) {
+      const float old = step[0], in = step[1];
+      for (unsigned int ms = 1; ms <= 1000000; ms = (ms < 10) ? ms + 1 : ms*3/2) {
+        float expected = rateLinearizedIIRLoop(old, in, gain, alpha, ms);
+        float actual = FSRateLinearizedIIR(old, in, gain, alpha, ms);
+        ASSERT_TRUE(std::isfinite(actual)) << "alpha " << alpha << " from " << old << " to " << in << " over " << ms << " ms";
+        EXPECT_NEAR(expected, actual, 0.01*std::fabs(in - old))
+            << "alpha " << alpha << " from " << old << " to " << in << " over " << ms << " ms";
+      }
+    }
+  }
+}
+
+
+TEST(FSRateLinearizedIIR, longStallsSettleOnInput) {
+  const float gain = exp(-0.001/0.03);
+  const unsigned int gaps[] = {10000, 19000, 20000, 30000, 60000, 1000000, 4000000000u};
+  for (unsigned int ms : gaps) {
+    EXPECT_EQ(1.0f, FSRateLinearizedIIR(0, 1, gain, 0.1, ms)) << ms << " ms";
+  }
+}
+
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
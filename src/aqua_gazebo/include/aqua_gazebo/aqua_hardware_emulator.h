@@ -38,6 +38,11 @@
 #include <tf/transform_broadcaster.h>
 #include <stdio.h>
 #include <random>
+#include <atomic>
+#include <memory>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 // ROS messages
 #include "sensor_msgs/Imu.h"
@@ -71,18 +76,28 @@
 #include "aquacore/SetDirection.h"
 #include "aquacore/IsCalibrated.h"
 #include "aquacore/PeriodicLegCommand.h"
+#include "aquacore/ImuPreintegration.h"
 #include <aquacore/SetPeriodicLegCommand.h>
 #include <aquacore/GetPeriodicLegCommand.h>
 #include <aquacore/SetTargetLegAngles.h>
 #include <aquacore/GetTargetLegAngles.h>
 #include <aquacore/StepSimulation.h>
 #include <aquacore/RunSimulationUntilTime.h>
+#include <aquacore/StepSimulationBatch.h>
+#include <aquacore/SaveEpisodeSnapshot.h>
+#include <aquacore/RestoreEpisodeSnapshot.h>
+#include <aquacore/PlayChoreography.h>
 
 #if ROS_VERSION_MINIMUM(1, 14, 3) // if current ros version is >= 1.14.3 (Melodic)
 #define ROS_MELODIC
 #endif
 
 #include <aqua_gait/Gaits.hpp>
+#include <aqua_gait/Choreography.hpp>
+#include <aqua_gazebo/farm_ring.h>
+#include <aqua_gazebo/imu_preintegrator.h>
+#include <aqua_gazebo/shared_leg_command.h>
+#include <aqua_gazebo/snapshot_buffer.h>
 
 #define NUM_LEGS 6
 const char* JOINT_NAMES[NUM_LEGS] =
@@ -93,10 +108,18 @@ const char* JOINT_NAMES[NUM_LEGS] =
 	 "right_mid_shoulder_joint",
 	 "right_rear_shoulder_joint"};
 
+// robot state sampled in the physics thread, to be published from the publisher thread
+struct PhysicsSample{
+    double joint_angles[NUM_LEGS];
+    double depth;
+    bool paused;
+};
+
 class AquaHWPlugin: public gazebo::ModelPlugin
 {
   public:
     AquaHWPlugin();
+    ~AquaHWPlugin();
     void Load(gazebo::physics::ModelPtr _parent, sdf::ElementPtr _sdf);
     void OnUpdate(const gazebo::common::UpdateInfo & info);
     void ImuCallback(const sensor_msgs::ImuConstPtr &msg);
@@ -115,10 +138,12 @@ class AquaHWPlugin: public gazebo::ModelPlugin
     bool zerodepth(std_srvs::Empty::Request  &req, std_srvs::Empty::Response &res);
     bool is_calibrated(aquacore::IsCalibrated::Request  &req, aquacore::IsCalibrated::Response &res);
     bool do_calibrate(std_srvs::Empty::Request  &req, std_srvs::Empty::Response &res);
-    void publish_health(const ros::TimerEvent& e);
+    void publish_health(const PhysicsSample& sample);
     aquacore::StateMsg current_state();
+    aquacore::StateMsg current_state(double depth);
     bool get_state(aquacore::GetState::Request  &req, aquacore::GetState::Response &res);
-    void publish_state(const ros::TimerEvent& e);
+    void publish_state(const PhysicsSample& sample);
+    void publisher_loop();
     void keepalive(const aquacore::KeepAlive::ConstPtr& msg);
     void keepalive(bool k=true);
     void process_command(const aquacore::Command::ConstPtr& msg);
@@ -127,8 +152,19 @@ class AquaHWPlugin: public gazebo::ModelPlugin
     void zerospeed();
     void failsafe(const ros::TimerEvent& e);
     void uwsg_controller_update(const ros::TimerEvent& e);
+    void update_controller();
+    double controller_time();
+    void read_joint_angles(double (&angles)[NUM_LEGS]);
+    void start_imu_preintegration();
+    void get_imu_preintegration(aquacore::ImuPreintegration &msg);
     bool step_simulation(aquacore::StepSimulation::Request  &req, aquacore::StepSimulation::Response &res);
     bool run_simulation_until_time(aquacore::RunSimulationUntilTime::Request  &req, aquacore::RunSimulationUntilTime::Response &res);
+    bool step_simulation_batch(aquacore::StepSimulationBatch::Request  &req, aquacore::StepSimulationBatch::Response &res);
+    int steps_for_duration(double duration);
+    void record_trajectory_sample();
+    bool save_episode_snapshot(aquacore::SaveEpisodeSnapshot::Request  &req, aquacore::SaveEpisodeSnapshot::Response &res);
+    bool restore_episode_snapshot(aquacore::RestoreEpisodeSnapshot::Request  &req, aquacore::RestoreEpisodeSnapshot::Response &res);
+    bool play_choreography(aquacore::PlayChoreography::Request  &req, aquacore::PlayChoreography::Response &res);
 
   private:
     boost::posix_time::ptime m_last_command_time;
@@ -139,6 +175,8 @@ class AquaHWPlugin: public gazebo::ModelPlugin
     gazebo::common::Time current_time;
     gazebo::physics::ModelPtr model;
     gazebo::physics::WorldPtr world;
+    gazebo::physics::JointPtr leg_joints[NUM_LEGS];
+    gazebo::physics::LinkPtr base_link, depth_sensor_link;
     gazebo::event::ConnectionPtr updateConnection;
 
     ros::NodeHandle* nh;
@@ -149,16 +187,18 @@ class AquaHWPlugin: public gazebo::ModelPlugin
     
     ros::Publisher state_pub, health_pub;
     ros::Subscriber cmd_sub, keepalive_sub, imu_sub, periodic_leg_command_sub, new_episode_sub;
-    ros::Timer failsafe_timer, state_broadcast_timer, health_broadcast_timer, uwsg_controller_timer;
+    ros::Timer failsafe_timer, uwsg_controller_timer;
     ros::ServiceServer pause_service, zerodepth_service, calibrate_service, 
                        is_calibrated_service, set_targetdepth_service, set_targetangles_service,
                        set_gait_service, dump_all_vars_service, get_autopilot_state_service,
                        get_autopilot_params_service,set_autopilot_param_service,set_autopilot_param_by_name_service,
                        get_autopilot_param_by_name_service, set_autopilot_mode_service, set_leg_params_service,
                        get_leg_params_service, set_direction_service, get_state_service,
-                       step_simulation_service, run_simulation_until_time_service;
+                       step_simulation_service, run_simulation_until_time_service, step_simulation_batch_service,
+                       save_episode_snapshot_service, restore_episode_snapshot_service, play_choreography_service;
     ros::ServiceClient get_leg_command_client, set_leg_command_client;
-    ros::ServiceClient get_target_angles_client, set_target_angles_client;
+    ros::ServiceClient get_target_angles_client;
+    AquaModelChannel::Ptr channel;
      
     std::string robot_namespace, imu_topic;
     double surface_level, depth_sensor_noise, aqua_shell_volume, fluid_density;
@@ -166,14 +206,53 @@ class AquaHWPlugin: public gazebo::ModelPlugin
 
     aquacore::Health health_msg;
     aquacore::StateMsg state_msg;
+    std::mutex state_msg_mutex;
 
     bool periodic_leg_command_active;
     bool _debug_print;
+    bool controller_in_physics_update;
+    double controller_period;
+    gazebo::common::Time last_controller_update_time;
+    double last_controller_time; // controller_time() at the latest tick; negative if none since a restore
+    // held by update_controller() and by episode save/restore: with the controller on the ROS
+    // timer, ticks run on another thread than the services and take no physics lock
+    std::mutex controller_mutex;
+
+    // state and health publishing, decoupled from the physics thread
+    enum {PUBLISH_STATE=1, PUBLISH_HEALTH=2};
+    unsigned int state_publish_divisor, health_publish_divisor;
+    uint64_t physics_steps;
+    SnapshotBuffer<PhysicsSample> physics_sample;
+    std::atomic<double> latest_depth;
+    std::atomic<unsigned int> publish_requests;
+    std::atomic<bool> publisher_running;
+    std::mutex publisher_mutex;
+    std::condition_variable publisher_cv;
+    std::thread publisher_thread;
+
+    // trajectory recording for step_simulation_batch; the buffer is sized before stepping so OnUpdate never allocates
+    std::atomic<bool> trajectory_recording;
+    unsigned int trajectory_record_every;
+    uint64_t trajectory_steps;
+    std::vector<double> trajectory;
     PeriodicLegState_t latest_periodic_leg_command;
     MotorTarget_t _motor_targets[6];
-    aquacore::SetPeriodicLegCommand plc_srv;
-    aquacore::SetTargetLegAngles ta_srv;
+
+    // choreography playback: services swap the table in atomically, and the controller
+    // keeps its own reference to the one it plays so that it can detect a new request
+    std::shared_ptr<const LegChoreography> choreography, playing_choreography;
+    double choreography_start_time;
+    // the gait is not updated during playback; it resumes from last_gait_update_time when playback ends
+    bool gait_suspended;
+    double last_gait_update_time;
     sensor_msgs::Imu latest_imu_msg;
     boost::array<double,NUM_LEGS> integrated_velocity;
+
+    // IMU integration between stepping calls; the tf and angular rate broadcasts are decimated
+    std::mutex imu_mutex;
+    ImuPreintegrator imu_preintegrator;
+    bool publish_imu_tf;
+    int imu_tf_decimation;
+    uint64_t imu_msg_count;
 };
 
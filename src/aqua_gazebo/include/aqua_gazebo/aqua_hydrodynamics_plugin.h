@@ -48,6 +48,8 @@
 #include <aquacore/SetPeriodicLegCommand.h>
 #include <aquacore/GetTargetLegAngles.h>
 #include <aquacore/SetTargetLegAngles.h>
+#include <aqua_gazebo/shared_leg_command.h>
+#include <aqua_gazebo/motor_pid.h>
 
 #if ROS_VERSION_MINIMUM(1, 14, 3) // if current ros version is >= 1.14.3 (Melodic)
 #define ROS_MELODIC
@@ -130,6 +132,10 @@ class AquaHydrodynamicsPlugin: public gazebo::ModelPlugin
     void OnUpdate(const gazebo::common::UpdateInfo & info);
     void DynamicReconfigureCallback(aqua_gazebo::HydrodynamicsConfig &config, uint32_t level);
     void InitDisturbances(int freq_components, double freq_noise, Eigen::MatrixXd vel_mean, Eigen::MatrixXd vel_cov);
+
+    // episode snapshots (see AquaModelChannel)
+    void SaveState(SnapshotWriter &writer);
+    bool RestoreState(SnapshotReader &reader);
     
     // flipper methods
     bool SetPeriodicLegCommand_cb(aquacore::SetPeriodicLegCommand::Request  &req, aquacore::SetPeriodicLegCommand::Response &res);
@@ -170,10 +176,11 @@ class AquaHydrodynamicsPlugin: public gazebo::ModelPlugin
     // flipper attributes
     gazebo::common::Time last_update_time;
     std::vector<gazebo::physics::JointPtr> motor_joints;
-    std::vector<gazebo::common::PID> pid;
+    std::vector<MotorPID> pid;
 
     ros::ServiceServer get_leg_command_service, set_leg_command_service;
     ros::ServiceServer get_target_angles_service, set_target_angles_service;
+    AquaModelChannel::Ptr channel;
     
     boost::array<double,NUM_LEGS> target_angles;
     ignition::math::Vector3<double> pid_gains;
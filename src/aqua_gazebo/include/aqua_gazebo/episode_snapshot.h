@@ -0,0 +1,98 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef AQUA_GAZEBO_EPISODE_SNAPSHOT_H
+#define AQUA_GAZEBO_EPISODE_SNAPSHOT_H
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Minimal binary serialization for episode snapshots. Values are copied as raw
+ * bytes, so snapshots are only meant to be restored by the same build of the
+ * plugins that saved them (they are tagged with EPISODE_SNAPSHOT_VERSION).
+ */
+#define EPISODE_SNAPSHOT_MAGIC 0x41515541u // "AQUA"
+#define EPISODE_SNAPSHOT_VERSION 2u
+
+class SnapshotWriter
+{
+  public:
+    explicit SnapshotWriter(std::vector<uint8_t> &data): data(data){}
+
+    template<typename T>
+    void write(const T *values, size_t n){
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot values must be trivially copyable");
+        const uint8_t *bytes = reinterpret_cast<const uint8_t*>(values);
+        data.insert(data.end(), bytes, bytes + n*sizeof(T));
+    }
+
+    template<typename T>
+    void write(const T &value){
+        write(&value, 1);
+    }
+
+  private:
+    std::vector<uint8_t> &data;
+};
+
+class SnapshotReader
+{
+  public:
+    SnapshotReader(const uint8_t *data, size_t size): data(data), size(size), offset(0){}
+
+    // returns false, leaving the values untouched, if the snapshot is too short
+    template<typename T>
+    bool read(T *values, size_t n){
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot values must be trivially copyable");
+        if (offset + n*sizeof(T) > size)
+            return false;
+        std::memcpy(values, data + offset, n*sizeof(T));
+        offset += n*sizeof(T);
+        return true;
+    }
+
+    template<typename T>
+    bool read(T &value){
+        return read(&value, 1);
+    }
+
+    bool done() const { return offset == size; }
+
+  private:
+    const uint8_t *data;
+    size_t size, offset;
+};
+
+#endif // AQUA_GAZEBO_EPISODE_SNAPSHOT_H
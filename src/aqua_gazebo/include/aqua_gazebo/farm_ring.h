@@ -0,0 +1,87 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef AQUA_GAZEBO_FARM_RING_H
+#define AQUA_GAZEBO_FARM_RING_H
+
+#include <atomic>
+#include <cstdint>
+
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+
+/**
+ * Number of values per physics step in the trajectories returned by
+ * step_simulation_batch. Each row holds, in order (see StepSimulationBatch.srv):
+ *   [0]      simulation time
+ *   [1-3]    base link position, world frame
+ *   [4-7]    base link orientation, world frame (quaternion x,y,z,w)
+ *   [8-10]   base link linear velocity, world frame
+ *   [11-13]  base link angular velocity, world frame
+ *   [14-16]  angular velocity, body frame
+ *   [17-19]  linear acceleration (specific force), body frame
+ *   [20-25]  joint angles
+ *   [26]     depth, without sensor noise
+ * Shared by the emulator plugin, which records the rows, and simulation_farm,
+ * which sizes its ring from them without linking against Gazebo.
+ */
+#define TRAJECTORY_STRIDE 27
+
+/**
+ * Layout of the shared-memory ring where simulation_farm merges the trajectories
+ * returned by all of its workers. The ring is a POSIX shared memory object
+ * (/dev/shm/<name>) holding a FarmRingHeader followed by `capacity` rows of
+ * `stride` doubles:
+ *   [0]     index of the worker that produced the row
+ *   [1]     sequence number of the batch request the row belongs to
+ *   [2...]  one row of a step_simulation_batch trajectory (see StepSimulationBatch.srv)
+ *
+ * Row k (counting from the start of the farm) lives at slot k % capacity.
+ * Writers append whole batches while holding write_mutex and then advance
+ * write_index. Readers keep their own read index, copy rows below write_index,
+ * and re-check write_index afterwards: if it advanced by more than capacity
+ * rows past their read index, the rows they copied were overwritten.
+ */
+#define FARM_RING_MAGIC 0x46524d31u // "FRM1"
+#define FARM_RING_ROW_HEADER 2
+
+struct FarmRingHeader
+{
+    uint32_t magic;
+    uint32_t stride;
+    uint64_t capacity;
+    std::atomic<uint64_t> write_index;
+    boost::interprocess::interprocess_mutex write_mutex;
+
+    double *rows(){ return reinterpret_cast<double*>(this + 1); }
+};
+
+#endif // AQUA_GAZEBO_FARM_RING_H
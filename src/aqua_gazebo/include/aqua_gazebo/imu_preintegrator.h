@@ -0,0 +1,188 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef AQUA_GAZEBO_IMU_PREINTEGRATOR_H
+#define AQUA_GAZEBO_IMU_PREINTEGRATOR_H
+
+#include <cmath>
+#include "Eigen/Dense"
+#include "Eigen/Geometry"
+
+/** Mutable state of an ImuPreintegrator as plain values, for episode snapshots */
+struct ImuPreintegratorState
+{
+    bool has_last_stamp;
+    double last_stamp;
+    double gyro_bias[3], accel_bias[3];
+    double delta_rotation[4]; // quaternion x,y,z,w
+    double delta_velocity[3], delta_position[3], gravity_start[3];
+    double delta_time;
+    unsigned int samples;
+};
+
+/**
+ * Strapdown IMU integration between two instants (e.g. two step_simulation calls).
+ *
+ * The deltas are expressed in the body frame at the start of the interval, in
+ * the usual preintegration form: delta_rotation takes vectors from the body
+ * frame at the end of the interval to the one at the start, and
+ * delta_velocity / delta_position are the velocity and position changes
+ * caused by the (gravity compensated) accelerations alone, i.e. the
+ * contribution of the initial velocity (v0*dt) is not part of delta_position.
+ *
+ * Gyro and accelerometer biases are estimated online with an exponential
+ * moving average, updated only while the robot is quasi-static.
+ */
+class ImuPreintegrator
+{
+  public:
+    /**
+     * accel_includes_gravity should be true for sensors reporting specific force
+     * (real IMUs, gazebo's imu sensor) and false for gazebo_ros_imu, which reports
+     * the kinematic acceleration of the body.
+     */
+    ImuPreintegrator(bool accel_includes_gravity=true, double gravity=9.80665, double bias_gain=1e-3,
+                     double static_gyro_threshold=0.02, double static_accel_threshold=0.2, double max_dt=0.1):
+        accel_includes_gravity(accel_includes_gravity),
+        gravity_world(0, 0, -gravity),
+        bias_gain(bias_gain),
+        static_gyro_threshold(static_gyro_threshold),
+        static_accel_threshold(static_accel_threshold),
+        max_dt(max_dt),
+        has_last_stamp(false),
+        last_stamp(0),
+        gyro_bias_(Eigen::Vector3d::Zero()),
+        accel_bias_(Eigen::Vector3d::Zero()){
+        reset();
+    }
+
+    // starts a new interval; bias estimates are kept
+    void reset(){
+        delta_rotation_.setIdentity();
+        delta_velocity_.setZero();
+        delta_position_.setZero();
+        gravity_start.setZero();
+        delta_time_ = 0;
+        samples_ = 0;
+    }
+
+    /**
+     * Integrates one measurement. orientation is the attitude reported by the
+     * IMU (body to world), only used for gravity compensation and static bias
+     * estimation. Returns false if the sample could not be integrated (the first
+     * sample ever, or a time gap larger than max_dt).
+     */
+    bool add(double stamp, const Eigen::Vector3d &gyro, const Eigen::Vector3d &accel, const Eigen::Quaterniond &orientation){
+        double dt = stamp - last_stamp;
+        bool valid = has_last_stamp && dt > 0 && dt <= max_dt;
+        has_last_stamp = true;
+        last_stamp = stamp;
+
+        // what the accelerometer should read when the robot is at rest
+        Eigen::Vector3d accel_at_rest = accel_includes_gravity ? Eigen::Vector3d(-(orientation.conjugate()*gravity_world)) : Eigen::Vector3d::Zero();
+        Eigen::Vector3d omega = gyro - gyro_bias_;
+        Eigen::Vector3d accel_residual = accel - accel_at_rest - accel_bias_;
+        if (omega.norm() < static_gyro_threshold && accel_residual.norm() < static_accel_threshold){
+            gyro_bias_ += bias_gain*omega;
+            accel_bias_ += bias_gain*accel_residual;
+        }
+
+        if (!valid)
+            return false;
+
+        if (samples_ == 0 && accel_includes_gravity){
+            // gravity expressed in the body frame at the start of the interval
+            gravity_start = orientation.conjugate()*gravity_world;
+        }
+
+        Eigen::Vector3d acc = delta_rotation_*(accel - accel_bias_) + gravity_start;
+        delta_position_ += delta_velocity_*dt + 0.5*acc*dt*dt;
+        delta_velocity_ += acc*dt;
+        double angle = omega.norm()*dt;
+        if (angle > 1e-12){
+            delta_rotation_ = (delta_rotation_*Eigen::Quaterniond(Eigen::AngleAxisd(angle, omega.normalized()))).normalized();
+        }
+        delta_time_ += dt;
+        samples_++;
+        return true;
+    }
+
+    const Eigen::Quaterniond& delta_rotation() const { return delta_rotation_; }
+    const Eigen::Vector3d& delta_velocity() const { return delta_velocity_; }
+    const Eigen::Vector3d& delta_position() const { return delta_position_; }
+    const Eigen::Vector3d& gyro_bias() const { return gyro_bias_; }
+    const Eigen::Vector3d& accel_bias() const { return accel_bias_; }
+    double delta_time() const { return delta_time_; }
+    unsigned int samples() const { return samples_; }
+
+    void saveState(ImuPreintegratorState &state) const{
+        state.has_last_stamp = has_last_stamp;
+        state.last_stamp = last_stamp;
+        Eigen::Map<Eigen::Vector3d>(state.gyro_bias) = gyro_bias_;
+        Eigen::Map<Eigen::Vector3d>(state.accel_bias) = accel_bias_;
+        Eigen::Map<Eigen::Vector4d>(state.delta_rotation) = delta_rotation_.coeffs();
+        Eigen::Map<Eigen::Vector3d>(state.delta_velocity) = delta_velocity_;
+        Eigen::Map<Eigen::Vector3d>(state.delta_position) = delta_position_;
+        Eigen::Map<Eigen::Vector3d>(state.gravity_start) = gravity_start;
+        state.delta_time = delta_time_;
+        state.samples = samples_;
+    }
+
+    void restoreState(const ImuPreintegratorState &state){
+        has_last_stamp = state.has_last_stamp;
+        last_stamp = state.last_stamp;
+        gyro_bias_ = Eigen::Map<const Eigen::Vector3d>(state.gyro_bias);
+        accel_bias_ = Eigen::Map<const Eigen::Vector3d>(state.accel_bias);
+        delta_rotation_.coeffs() = Eigen::Map<const Eigen::Vector4d>(state.delta_rotation);
+        delta_velocity_ = Eigen::Map<const Eigen::Vector3d>(state.delta_velocity);
+        delta_position_ = Eigen::Map<const Eigen::Vector3d>(state.delta_position);
+        gravity_start = Eigen::Map<const Eigen::Vector3d>(state.gravity_start);
+        delta_time_ = state.delta_time;
+        samples_ = state.samples;
+    }
+
+  private:
+    bool accel_includes_gravity;
+    Eigen::Vector3d gravity_world;
+    double bias_gain, static_gyro_threshold, static_accel_threshold, max_dt;
+
+    bool has_last_stamp;
+    double last_stamp;
+    Eigen::Vector3d gyro_bias_, accel_bias_;
+
+    Eigen::Quaterniond delta_rotation_;
+    Eigen::Vector3d delta_velocity_, delta_position_, gravity_start;
+    double delta_time_;
+    unsigned int samples_;
+};
+
+#endif // AQUA_GAZEBO_IMU_PREINTEGRATOR_H
@@ -0,0 +1,102 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef AQUA_GAZEBO_MOTOR_PID_H
+#define AQUA_GAZEBO_MOTOR_PID_H
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * Position controller of the flipper motors. Same update as gazebo::common::PID
+ * (the integral error accumulates i_gain*dt*error and is clamped to
+ * [i_min, i_max]), but with its state exposed, so that episode snapshots can
+ * restore it exactly; common::PID has no setters for its errors.
+ */
+class MotorPID
+{
+  public:
+    MotorPID(){ Init(0.0, 0.0, 0.0, 0.0, 0.0, -1.0, 0.0); }
+
+    // The command is only clamped when cmd_max >= cmd_min, as in common::PID
+    void Init(double p_gain, double i_gain, double d_gain, double i_max, double i_min,
+              double cmd_max, double cmd_min){
+        this->p_gain = p_gain;
+        this->i_gain = i_gain;
+        this->d_gain = d_gain;
+        this->i_max = i_max;
+        this->i_min = i_min;
+        this->cmd_max = cmd_max;
+        this->cmd_min = cmd_min;
+        Reset();
+    }
+
+    void Reset(){
+        p_err_last = 0.0;
+        i_err = 0.0;
+        cmd = 0.0;
+    }
+
+    double Update(double error, double dt){
+        if (dt == 0.0 || std::isnan(error) || std::isinf(error))
+            return 0.0;
+
+        i_err = std::min(std::max(i_err + i_gain*dt*error, i_min), i_max);
+        double d_err = (error - p_err_last)/dt;
+        p_err_last = error;
+
+        cmd = -p_gain*error - i_err - d_gain*d_err;
+        if (cmd_max >= cmd_min)
+            cmd = std::min(std::max(cmd, cmd_min), cmd_max);
+        return cmd;
+    }
+
+    double GetCmd() const { return cmd; }
+
+    // The whole state carried between updates: the last error and the integral term
+    void GetState(double &p_err, double &i_err) const {
+        p_err = p_err_last;
+        i_err = this->i_err;
+    }
+
+    void SetState(double p_err, double i_err){
+        p_err_last = p_err;
+        this->i_err = i_err;
+    }
+
+  private:
+    double p_gain, i_gain, d_gain;
+    double i_max, i_min, cmd_max, cmd_min;
+    double p_err_last, i_err, cmd;
+};
+
+#endif // AQUA_GAZEBO_MOTOR_PID_H
@@ -0,0 +1,109 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef AQUA_GAZEBO_SHARED_LEG_COMMAND_H
+#define AQUA_GAZEBO_SHARED_LEG_COMMAND_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <aqua_gazebo/episode_snapshot.h>
+#include <aqua_gazebo/snapshot_buffer.h>
+
+#define NUM_LEG_COMMANDS 6
+
+/**
+ * Leg command sent from the hardware emulator to the hydrodynamics plugin on
+ * every controller update: the motor targets computed by UnderwaterSwimmerGait
+ * plus the periodic leg command they were generated from (used by the thrust
+ * model).
+ */
+struct SharedLegCommand
+{
+    double target_angles[NUM_LEG_COMMANDS];
+    double amplitudes[NUM_LEG_COMMANDS];
+    double frequencies[NUM_LEG_COMMANDS];
+    double leg_offsets[NUM_LEG_COMMANDS];
+    double phase_offsets[NUM_LEG_COMMANDS];
+
+    SharedLegCommand(){
+        for (int i=0; i<NUM_LEG_COMMANDS; i++){
+            target_angles[i] = amplitudes[i] = frequencies[i] = leg_offsets[i] = phase_offsets[i] = 0.0;
+        }
+    }
+};
+
+/**
+ * In-process channel between the plugins attached to the same model. The
+ * plugins live in the same gzserver process, so they can exchange leg commands
+ * through shared memory instead of ROS service calls.
+ *
+ * Channels are registered per model (by scoped name) and created by whichever
+ * plugin asks first, so plugin load order does not matter. The registry is a
+ * function-local static of an inline function, which the dynamic linker
+ * unifies across the plugin libraries loaded into gzserver.
+ */
+class AquaModelChannel
+{
+  public:
+    typedef std::shared_ptr<AquaModelChannel> Ptr;
+
+    static Ptr Get(const std::string &model_name){
+        static std::mutex registry_mutex;
+        static std::map<std::string, std::weak_ptr<AquaModelChannel> > registry;
+
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        Ptr channel = registry[model_name].lock();
+        if (!channel){
+            channel = std::make_shared<AquaModelChannel>();
+            registry[model_name] = channel;
+        }
+        return channel;
+    }
+
+    // written by the hardware emulator, read by the hydrodynamics plugin
+    SnapshotBuffer<SharedLegCommand> leg_command;
+
+    // registered by the hydrodynamics plugin so its internal state (motor PIDs,
+    // disturbance filters) is included in the hardware emulator's episode snapshots.
+    // Both are called with the world paused and physics_mutex held.
+    std::function<void(SnapshotWriter&)> save_hydrodynamics_state;
+    std::function<bool(SnapshotReader&)> restore_hydrodynamics_state;
+
+    // held by the plugins' OnUpdate while a snapshot is being restored
+    std::mutex physics_mutex;
+};
+
+#endif // AQUA_GAZEBO_SHARED_LEG_COMMAND_H
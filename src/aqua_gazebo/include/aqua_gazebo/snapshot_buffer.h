@@ -0,0 +1,88 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef AQUA_GAZEBO_SNAPSHOT_BUFFER_H
+#define AQUA_GAZEBO_SNAPSHOT_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Lock-free single-writer / single-reader snapshot of a value of type T
+ * (a.k.a. triple buffer).
+ *
+ * The writer fills its private back buffer and publishes it with a single
+ * atomic exchange; the reader picks up the most recent published buffer with
+ * another atomic exchange. Neither side ever blocks or waits for the other,
+ * and the buffer being read is never written concurrently. Intermediate
+ * values are dropped if the writer publishes faster than the reader polls.
+ */
+template <typename T>
+class SnapshotBuffer
+{
+  public:
+    SnapshotBuffer() : middle(1), back(0), front(2) {}
+
+    // writer side: fill the buffer returned by writeBuffer(), then publish()
+    T& writeBuffer(){ return buffers[back]; }
+
+    void publish(){
+        back = middle.exchange(back | DIRTY, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    void write(const T &value){
+        buffers[back] = value;
+        publish();
+    }
+
+    // reader side: returns true if a new value was published since the last call
+    bool update(){
+        if (!(middle.load(std::memory_order_relaxed) & DIRTY))
+            return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    // reader side: the latest value obtained by update()
+    const T& read() const { return buffers[front]; }
+
+  private:
+    static const uint8_t INDEX_MASK = 0x3;
+    static const uint8_t DIRTY = 0x4;
+
+    T buffers[3];
+    std::atomic<uint8_t> middle;
+    uint8_t back;  // only touched by the writer
+    uint8_t front; // only touched by the reader
+};
+
+#endif // AQUA_GAZEBO_SNAPSHOT_BUFFER_H
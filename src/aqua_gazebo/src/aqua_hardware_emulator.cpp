@@ -39,16 +39,64 @@ std::random_device rd;
 std::mt19937 gen(rd());
 
 
-AquaHWPlugin::AquaHWPlugin(){
+AquaHWPlugin::AquaHWPlugin():
+    uwsg_controller(std::bind(&AquaHWPlugin::controller_time, this)),
+    controller_in_physics_update(false),
+    last_controller_time(-1),
+    state_publish_divisor(1),
+    health_publish_divisor(1),
+    physics_steps(0),
+    latest_depth(0.0),
+    publish_requests(0),
+    publisher_running(false),
+    trajectory_recording(false),
+    trajectory_record_every(1),
+    trajectory_steps(0),
+    choreography_start_time(0),
+    gait_suspended(false),
+    last_gait_update_time(0),
+    publish_imu_tf(true),
+    imu_tf_decimation(1),
+    imu_msg_count(0){
 
 }
 
+AquaHWPlugin::~AquaHWPlugin(){
+    if (publisher_thread.joinable()){
+        publisher_running = false;
+        publisher_cv.notify_all();
+        publisher_thread.join();
+    }
+}
+
+// converts a publishing rate in Hz to a number of physics steps between messages
+static unsigned int rate_to_divisor(double rate, double step_size){
+    if (rate <= 0 || step_size <= 0)
+        return 1;
+    return std::max(1, (int)std::lround(1.0/(rate*step_size)));
+}
+
 void AquaHWPlugin::Load(gazebo::physics::ModelPtr _parent, sdf::ElementPtr _sdf){
     ROS_INFO("Loading the AquaHW emulator plugin");
     model = _parent;
     world = model->GetWorld();
     robot_namespace.clear();
 
+    // resolve joint and link handles once, instead of looking them up by name on every step
+    for (int i=0; i< NUM_LEGS; i++){
+        leg_joints[i] = model->GetJoint(JOINT_NAMES[i]);
+        if (!leg_joints[i]){
+            ROS_FATAL_STREAM("aquahw plugin could not find joint " << JOINT_NAMES[i]);
+            return;
+        }
+    }
+    base_link = model->GetLink("aqua_base");
+    depth_sensor_link = model->GetLink("depth_sensor");
+    if (!base_link || !depth_sensor_link){
+        ROS_FATAL("aquahw plugin could not find the aqua_base and depth_sensor links");
+        return;
+    }
+
     // Make sure the ROS node for Gazebo has already been initialized
     if (!ros::isInitialized()){
         ROS_FATAL_STREAM("A ROS node for Gazebo has not been initialized, unable to load plugin. "
@@ -90,7 +138,7 @@ void AquaHWPlugin::Load(gazebo::physics::ModelPtr _parent, sdf::ElementPtr _sdf)
     nh = new ros::NodeHandle(robot_namespace);
 
     // Get parameters
-    double state_publish_rate, health_publish_rate, leg_amplitude, leg_period, failsafe_timer_period, controller_period;
+    double state_publish_rate, health_publish_rate, leg_amplitude, leg_period, failsafe_timer_period;
     nh->param<double>("state_publish_rate", state_publish_rate, 10.0); //10Hz
     nh->param<double>("health_publish_rate", health_publish_rate, 2.0); //2Hz
     nh->param<double>("leg_amplitude", leg_amplitude, 20); 
@@ -98,6 +146,31 @@ void AquaHWPlugin::Load(gazebo::physics::ModelPtr _parent, sdf::ElementPtr _sdf)
     nh->param<double>("failsafe_timer_period_secs", failsafe_timer_period, 1.0); 
     nh->param<double>("controller_period_secs", controller_period, 0.001); 
     nh->param<bool>("debug_print", _debug_print, false); 
+    // if true, the gait controller runs on simulation time from within OnUpdate instead of on a wall-clock timer
+    nh->param<bool>("controller_in_physics_update", controller_in_physics_update, false);
+
+    // state and health messages go out every N physics steps; by default N is derived from the publish rates
+#ifdef ROS_MELODIC
+    double step_size = world->Physics()->GetMaxStepSize();
+#else
+    double step_size = world->GetPhysicsEngine()->GetMaxStepSize();
+#endif
+    int divisor;
+    nh->param<int>("state_publish_divisor", divisor, rate_to_divisor(state_publish_rate, step_size));
+    state_publish_divisor = std::max(divisor, 1);
+    nh->param<int>("health_publish_divisor", divisor, rate_to_divisor(health_publish_rate, step_size));
+    health_publish_divisor = std::max(divisor, 1);
+
+    // IMU integration. gazebo_ros_imu reports kinematic accelerations, without gravity
+    bool imu_includes_gravity;
+    double imu_bias_gain;
+    nh->param<bool>("imu_includes_gravity", imu_includes_gravity, false);
+    nh->param<double>("imu_bias_gain", imu_bias_gain, 1e-3);
+    imu_preintegrator = ImuPreintegrator(imu_includes_gravity, 9.80665, imu_bias_gain);
+    // the orientation tf and the angular rate are broadcast once every imu_tf_decimation IMU messages
+    nh->param<bool>("publish_imu_tf", publish_imu_tf, true);
+    nh->param<int>("imu_tf_decimation", imu_tf_decimation, 10);
+    imu_tf_decimation = std::max(imu_tf_decimation, 1);
 
     // Initialize publishers and subscribers
     state_pub = nh->advertise<aquacore::StateMsg>("state", 1);
@@ -112,10 +185,10 @@ void AquaHWPlugin::Load(gazebo::physics::ModelPtr _parent, sdf::ElementPtr _sdf)
 
     // Initialize Timers
     failsafe_timer = nh->createTimer(ros::Duration(failsafe_timer_period), &AquaHWPlugin::failsafe, this,false);
-    state_broadcast_timer = nh->createTimer(ros::Duration(1.0/state_publish_rate), &AquaHWPlugin::publish_state, this);
-    health_broadcast_timer = nh->createTimer(ros::Duration(1.0/health_publish_rate), &AquaHWPlugin::publish_health, this);
     // This is for ensuring that the UnderwaterSwimmerGait::update function gets called at a 1KHz rate
-    uwsg_controller_timer = nh->createTimer(ros::Duration(controller_period), &AquaHWPlugin::uwsg_controller_update, this);
+    if (!controller_in_physics_update){
+        uwsg_controller_timer = nh->createTimer(ros::Duration(controller_period), &AquaHWPlugin::uwsg_controller_update, this);
+    }
 
     // Initialize services
     pause_service = nh->advertiseService("pause", &AquaHWPlugin::pause,this);
@@ -136,12 +209,18 @@ void AquaHWPlugin::Load(gazebo::physics::ModelPtr _parent, sdf::ElementPtr _sdf)
     get_state_service = nh->advertiseService("get_state", &AquaHWPlugin::get_state,this);
     step_simulation_service = nh->advertiseService("step_simulation", &AquaHWPlugin::step_simulation,this);
     run_simulation_until_time_service = nh->advertiseService("run_until_time", &AquaHWPlugin::run_simulation_until_time,this);
+    step_simulation_batch_service = nh->advertiseService("step_simulation_batch", &AquaHWPlugin::step_simulation_batch,this);
+    save_episode_snapshot_service = nh->advertiseService("save_episode_snapshot", &AquaHWPlugin::save_episode_snapshot,this);
+    restore_episode_snapshot_service = nh->advertiseService("restore_episode_snapshot", &AquaHWPlugin::restore_episode_snapshot,this);
+    play_choreography_service = nh->advertiseService("play_choreography", &AquaHWPlugin::play_choreography,this);
 
     set_leg_command_client = nh->serviceClient<aquacore::SetPeriodicLegCommand>("set_leg_command", true);
     get_leg_command_client = nh->serviceClient<aquacore::GetPeriodicLegCommand>("get_leg_command", true);
-    set_target_angles_client = nh->serviceClient<aquacore::SetTargetLegAngles>("set_target_joint_angles", true);
     get_target_angles_client = nh->serviceClient<aquacore::GetTargetLegAngles>("get_target_joint_angles", true);
 
+    // leg targets are sent to the hydrodynamics plugin in-process; its ROS services remain for external clients
+    channel = AquaModelChannel::Get(model->GetScopedName());
+
     // initialize the leg joint angles vector.
     health_msg.positions = std::vector<float>(6,0);
 
@@ -162,9 +241,14 @@ void AquaHWPlugin::Load(gazebo::physics::ModelPtr _parent, sdf::ElementPtr _sdf)
     state = SWIM;
     world->SetPaused(false);
     integrated_velocity.fill(0.0);
+
+    // state and health messages are serialized and published from their own thread
+    publisher_running = true;
+    publisher_thread = std::thread(&AquaHWPlugin::publisher_loop, this);
 }
 
 void AquaHWPlugin::OnUpdate(const gazebo::common::UpdateInfo & info){
+    std::lock_guard<std::mutex> physics_lock(channel->physics_mutex);
     auto previous_time = current_time;
 #ifdef ROS_MELODIC
     current_time = model->GetWorld()->SimTime();
@@ -172,42 +256,145 @@ void AquaHWPlugin::OnUpdate(const gazebo::common::UpdateInfo & info){
     current_time = model->GetWorld()->GetSimTime();
 #endif
 
-    // get joint positions
-    for (int i=0; i< NUM_LEGS; i++){
+    // run the gait controller on simulation time, decimated to the controller period
+    if (controller_in_physics_update){
+        if (current_time < last_controller_update_time){
+            // simulation time was reset
+            last_controller_update_time = current_time;
+        }
+        if ((current_time - last_controller_update_time).Double() >= controller_period - 1e-9){
+            last_controller_update_time = current_time;
+            update_controller();
+        }
+    }
+
+    if (trajectory_recording){
+        record_trajectory_sample();
+        // a batch can step for longer than the failsafe timeout without any command coming in
+        keepalive(true);
+    }
+
+    // sample the robot state for the publisher thread, only on the steps where something is due
+    physics_steps++;
+    unsigned int requests = 0;
+    if (physics_steps % state_publish_divisor == 0)
+        requests |= PUBLISH_STATE;
+    if (physics_steps % health_publish_divisor == 0)
+        requests |= PUBLISH_HEALTH;
+
+    if (requests){
+        PhysicsSample &sample = physics_sample.writeBuffer();
+        read_joint_angles(sample.joint_angles);
 #ifdef ROS_MELODIC
-        health_msg.positions[i] = model->GetJoint(JOINT_NAMES[i])->Position(1);
+        sample.depth = surface_level - depth_sensor_link->WorldPose().Pos().Z();
 #else
-        health_msg.positions[i] = model->GetJoint(JOINT_NAMES[i])->GetAngle(1).Radian();
+        sample.depth = surface_level - depth_sensor_link->GetWorldPose().pos.z;
 #endif
+        // add some noise
+        sample.depth += gaussian_noise(gen);
+        sample.paused = world->IsPaused();
+        latest_depth = sample.depth;
+        physics_sample.publish();
+
+        // never blocks; the publisher thread also wakes up periodically in case this notification is missed
+        publish_requests.fetch_or(requests);
+        publisher_cv.notify_one();
     }
+}
 
+void AquaHWPlugin::publisher_loop(){
+    std::unique_lock<std::mutex> lock(publisher_mutex);
+    while (publisher_running){
+        publisher_cv.wait_for(lock, std::chrono::milliseconds(10),
+                [this]{ return publish_requests != 0 || !publisher_running; });
+        unsigned int requests = publish_requests.exchange(0);
+        if (!requests)
+            continue;
+        lock.unlock();
+
+        physics_sample.update();
+        const PhysicsSample &sample = physics_sample.read();
+        if (requests & PUBLISH_HEALTH)
+            publish_health(sample);
+        if (requests & PUBLISH_STATE)
+            publish_state(sample);
+
+        lock.lock();
+    }
+}
+
+void AquaHWPlugin::read_joint_angles(double (&angles)[NUM_LEGS]){
+    for (int i=0; i< NUM_LEGS; i++){
 #ifdef ROS_MELODIC
-    state_msg.Depth = surface_level - model->GetLink("depth_sensor")->WorldPose().Pos().Z();
+        angles[i] = leg_joints[i]->Position(1);
 #else
-    state_msg.Depth = surface_level - model->GetLink("depth_sensor")->GetWorldPose().pos.z;
+        angles[i] = leg_joints[i]->GetAngle(1).Radian();
 #endif
+    }
+}
 
-    // add some noise
-    state_msg.Depth += gaussian_noise(gen);
+void AquaHWPlugin::uwsg_controller_update(const ros::TimerEvent& e){
+    update_controller();
+}
 
-    // publish current state and health messages only if the simulation is not paused
-    auto now =  ros::Time::now();
-    health_msg.header.stamp = now;
-    state_msg.header.stamp = now;
-    
-    health_pub.publish(health_msg);
-    if (!world->IsPaused()){
-        state_pub.publish(state_msg);
+double AquaHWPlugin::controller_time(){
+    if (controller_in_physics_update && world){
+#ifdef ROS_MELODIC
+        return world->SimTime().Double();
+#else
+        return world->GetSimTime().Double();
+#endif
     }
+    return UnderwaterSwimmerGait::MMReadTime();
 }
 
-void AquaHWPlugin::uwsg_controller_update(const ros::TimerEvent& e){
-    if( !periodic_leg_command_active){
-        uwsg_controller.updateSineCmd(latest_periodic_leg_command);
+void AquaHWPlugin::update_controller(){
+    std::lock_guard<std::mutex> controller_lock(controller_mutex);
+    // one clock read per tick, shared by both gait updates
+    double now = controller_time();
+    double previous_time = (last_controller_time >= 0 && last_controller_time <= now) ? last_controller_time : now;
+
+    // simulation time goes backwards when the world is reset; shift the gait and choreography
+    // timestamps by the same amount, so that they carry on instead of stalling until the clock catches up
+    if (last_controller_time >= 0 && now < last_controller_time){
+        UnderwaterSwimmerGaitState_t gait_state;
+        uwsg_controller.saveState(last_controller_time, gait_state);
+        uwsg_controller.restoreState(now, gait_state);
+        choreography_start_time += now - last_controller_time;
+        last_gait_update_time += now - last_controller_time;
     }
+    last_controller_time = now;
 
-    uwsg_controller.setPeriodicLegCmd(latest_periodic_leg_command);
-    uwsg_controller.updateMotorTarget(_motor_targets);
+    // a loaded choreography overrides the gait until it ends; playback starts on the first tick that sees it
+    std::shared_ptr<const LegChoreography> latest_choreography = std::atomic_load(&choreography);
+    if (latest_choreography != playing_choreography){
+        playing_choreography = latest_choreography;
+        choreography_start_time = now;
+    }
+    bool choreographed = playing_choreography && playing_choreography->sample(now - choreography_start_time, _motor_targets);
+
+    if (!choreographed){
+        if (gait_suspended){
+            // resume the gait as if it had been paused since its last update before playback, from the
+            // pose the choreography ended in, so that its transient filter blends back into the sine
+            UnderwaterSwimmerGaitState_t gait_state;
+            uwsg_controller.saveState(last_gait_update_time, gait_state);
+            std::copy(_motor_targets, _motor_targets + 6, gait_state.FSLatestMotorTargets);
+            uwsg_controller.restoreState(previous_time, gait_state);
+            gait_suspended = false;
+        }
+
+        if( !periodic_leg_command_active){
+            uwsg_controller.updateSineCmd(now, latest_periodic_leg_command);
+        }
+
+        uwsg_controller.setPeriodicLegCmd(latest_periodic_leg_command);
+        uwsg_controller.updateMotorTarget(now, _motor_targets);
+        last_gait_update_time = now;
+    }
+    else{
+        gait_suspended = true;
+    }
 
     /*for(int i=0;i<6;i++){
       ROS_INFO("Leg [%d] -> ampl: [%f] freq: [%f] phase: [%f] offset: [%f]",i,latest_periodic_leg_command.amplitudes[i],latest_periodic_leg_command.frequencies[i],latest_periodic_leg_command.phase_offsets[i],latest_periodic_leg_command.leg_offsets[i]);
@@ -215,52 +402,88 @@ void AquaHWPlugin::uwsg_controller_update(const ros::TimerEvent& e){
       */
     //ROS_INFO("Motor targets are: [%f %f %f %f %f %f]",_motor_targets[0].pos,_motor_targets[1].pos,_motor_targets[2].pos,_motor_targets[3].pos,_motor_targets[4].pos,_motor_targets[5].pos);
 
+    // hand the new targets to the hydrodynamics plugin through the in-process channel
+    SharedLegCommand &cmd = channel->leg_command.writeBuffer();
     for (int i=0; i<6; i++){
-        ta_srv.request.target_angles[i] = _motor_targets[i].pos;
-        plc_srv.request.amplitudes[i] = latest_periodic_leg_command.amplitudes[i];
-        plc_srv.request.frequencies[i] = latest_periodic_leg_command.frequencies[i];
-        plc_srv.request.leg_offsets[i] = latest_periodic_leg_command.leg_offsets[i];
-        plc_srv.request.phase_offsets[i] = latest_periodic_leg_command.phase_offsets[i];
+        cmd.target_angles[i] = _motor_targets[i].pos;
+        cmd.amplitudes[i] = latest_periodic_leg_command.amplitudes[i];
+        cmd.frequencies[i] = latest_periodic_leg_command.frequencies[i];
+        cmd.leg_offsets[i] = latest_periodic_leg_command.leg_offsets[i];
+        cmd.phase_offsets[i] = latest_periodic_leg_command.phase_offsets[i];
     }
-    set_target_angles_client.call(ta_srv);
-    set_leg_command_client.call(plc_srv);
+    channel->leg_command.publish();
 }
 
 void AquaHWPlugin::ImuCallback(const sensor_msgs::ImuConstPtr &msg){
     tf::Quaternion q;
     tf::quaternionMsgToTF(msg->orientation,q);
     
-    tf::Transform transform;
-    transform.setOrigin( tf::Vector3( 0,0,0 ) );
-    transform.setRotation( q );
-    tf_br.sendTransform( tf::StampedTransform( transform, msg->header.stamp, "/latest_fix", "/aqua_base" ));
-    
-    geometry_msgs::Twist current_velocity;
-    current_velocity.linear.x = 0;
-    current_velocity.linear.y = 0;
-    current_velocity.linear.z = 0;
-
-    current_velocity.angular.x = msg->angular_velocity.x;
-    current_velocity.angular.y = msg->angular_velocity.y;
-    current_velocity.angular.z = msg->angular_velocity.z;
-
-    rate_pub.publish(current_velocity);
+    if (publish_imu_tf && (imu_msg_count++) % imu_tf_decimation == 0){
+        tf::Transform transform;
+        transform.setOrigin( tf::Vector3( 0,0,0 ) );
+        transform.setRotation( q );
+        tf_br.sendTransform( tf::StampedTransform( transform, msg->header.stamp, "/latest_fix", "/aqua_base" ));
+
+        if (rate_pub.getNumSubscribers() > 0){
+            geometry_msgs::Twist current_velocity;
+            current_velocity.angular.x = msg->angular_velocity.x;
+            current_velocity.angular.y = msg->angular_velocity.y;
+            current_velocity.angular.z = msg->angular_velocity.z;
+            rate_pub.publish(current_velocity);
+        }
+    }
     
     double roll,pitch,yaw;
     tf::Matrix3x3(q).getRPY(roll,pitch,yaw);
-    state_msg.RollAngle = roll * 180.0 / M_PI;
-    state_msg.PitchAngle = -pitch * 180.0 / M_PI;
-    state_msg.YawAngle = -yaw * 180.0 / M_PI;
-    
-    double dt = (msg->header.stamp - latest_imu_msg.header.stamp).toSec();
+    {
+        std::lock_guard<std::mutex> state_lock(state_msg_mutex);
+        state_msg.RollAngle = roll * 180.0 / M_PI;
+        state_msg.PitchAngle = -pitch * 180.0 / M_PI;
+        state_msg.YawAngle = -yaw * 180.0 / M_PI;
+    }
 
-    integrated_velocity[0] += msg->linear_acceleration.x*dt;
-    integrated_velocity[1] += msg->linear_acceleration.y*dt;
-    integrated_velocity[2] += msg->linear_acceleration.z*dt;
+    std::lock_guard<std::mutex> lock(imu_mutex);
+    imu_preintegrator.add(msg->header.stamp.toSec(),
+            Eigen::Vector3d(msg->angular_velocity.x, msg->angular_velocity.y, msg->angular_velocity.z),
+            Eigen::Vector3d(msg->linear_acceleration.x, msg->linear_acceleration.y, msg->linear_acceleration.z),
+            Eigen::Quaterniond(msg->orientation.w, msg->orientation.x, msg->orientation.y, msg->orientation.z));
+    const Eigen::Vector3d &dv = imu_preintegrator.delta_velocity();
+    integrated_velocity[0] = dv[0];
+    integrated_velocity[1] = dv[1];
+    integrated_velocity[2] = dv[2];
 
     latest_imu_msg = (*msg.get());
 }
 
+void AquaHWPlugin::start_imu_preintegration(){
+    std::lock_guard<std::mutex> lock(imu_mutex);
+    imu_preintegrator.reset();
+    integrated_velocity.fill(0.0);
+}
+
+void AquaHWPlugin::get_imu_preintegration(aquacore::ImuPreintegration &msg){
+    std::lock_guard<std::mutex> lock(imu_mutex);
+    const ImuPreintegrator &p = imu_preintegrator;
+    msg.delta_time = p.delta_time();
+    msg.samples = p.samples();
+    msg.delta_rotation.x = p.delta_rotation().x();
+    msg.delta_rotation.y = p.delta_rotation().y();
+    msg.delta_rotation.z = p.delta_rotation().z();
+    msg.delta_rotation.w = p.delta_rotation().w();
+    msg.delta_velocity.x = p.delta_velocity()[0];
+    msg.delta_velocity.y = p.delta_velocity()[1];
+    msg.delta_velocity.z = p.delta_velocity()[2];
+    msg.delta_position.x = p.delta_position()[0];
+    msg.delta_position.y = p.delta_position()[1];
+    msg.delta_position.z = p.delta_position()[2];
+    msg.gyro_bias.x = p.gyro_bias()[0];
+    msg.gyro_bias.y = p.gyro_bias()[1];
+    msg.gyro_bias.z = p.gyro_bias()[2];
+    msg.accel_bias.x = p.accel_bias()[0];
+    msg.accel_bias.y = p.accel_bias()[1];
+    msg.accel_bias.z = p.accel_bias()[2];
+}
+
 bool AquaHWPlugin::set_direction(aquacore::SetDirection::Request  &req,
         aquacore::SetDirection::Response &res){
     //
@@ -362,6 +585,7 @@ bool AquaHWPlugin::set_targetangles(aquacore::SetTargetAngles::Request  &req, aq
     uwsg_controller.pitchControl(req.target_pitch);
     uwsg_controller.yawControl(req.target_yaw);
 
+    std::lock_guard<std::mutex> state_lock(state_msg_mutex);
     state_msg.RollTargetAngle = req.target_roll;
     state_msg.PitchTargetAngle = req.target_pitch;
     state_msg.YawTargetAngle= req.target_yaw;
@@ -453,7 +677,11 @@ bool AquaHWPlugin::do_calibrate(std_srvs::Empty::Request  &req,
     return true;
 }
 
-void AquaHWPlugin::publish_health(const ros::TimerEvent& e){
+void AquaHWPlugin::publish_health(const PhysicsSample& sample){
+    // skip serialization entirely when nobody is listening
+    if (health_pub.getNumSubscribers() == 0)
+        return;
+
     //StateProxyStructure_t health= lite.GetHealthState();
     //aquacore::Health::Ptr hmsg (new aquacore::Health);
     //hmsg->positions.insert(hmsg->positions.end(),health.positions, health.positions+6);
@@ -473,11 +701,17 @@ void AquaHWPlugin::publish_health(const ros::TimerEvent& e){
     ////    hmsg->roll = health.roll;
     ////    hmsg->dip = health.dip;
 
+    std::copy(sample.joint_angles, sample.joint_angles + NUM_LEGS, health_msg.positions.begin());
+    health_msg.header.stamp = ros::Time::now();
     health_pub.publish(health_msg);
 }
 
 
 aquacore::StateMsg AquaHWPlugin::current_state(){
+    return current_state(latest_depth);
+}
+
+aquacore::StateMsg AquaHWPlugin::current_state(double depth){
     //state_msg.LED = state.LEDsOn;
     //state_msg.Gait = cmds.gaitselect;
 
@@ -500,9 +734,16 @@ aquacore::StateMsg AquaHWPlugin::current_state(){
     //state_msg.AvgSurgeCommand=state.Display2;
     //state_msg.Speed = lite.GetSpeed();
 
-    state_msg.header.stamp = ros::Time::now();
+    // the message is shared with the IMU and command callbacks, so publish a copy taken under the lock
+    aquacore::StateMsg msg;
+    {
+        std::lock_guard<std::mutex> state_lock(state_msg_mutex);
+        msg = state_msg;
+    }
+    msg.Depth = depth;
+    msg.header.stamp = ros::Time::now();
 
-    return state_msg;
+    return msg;
 }
 
 bool AquaHWPlugin::get_state(aquacore::GetState::Request  &req,
@@ -511,9 +752,10 @@ bool AquaHWPlugin::get_state(aquacore::GetState::Request  &req,
     return true;
 }
 
-void AquaHWPlugin::publish_state(const ros::TimerEvent& e){
-    if (!world->IsPaused()){
-        state_pub.publish(current_state());
+void AquaHWPlugin::publish_state(const PhysicsSample& sample){
+    // publish current state only if the simulation is not paused and somebody is listening
+    if (!sample.paused && state_pub.getNumSubscribers() > 0){
+        state_pub.publish(current_state(sample.depth));
     }
 }
 
@@ -556,6 +798,7 @@ void AquaHWPlugin::process_command(const aquacore::Command::ConstPtr& msg)
     uwsg_controller.setSpeedCmd(speed);
     uwsg_controller.heaveControl(heave);
 
+    std::lock_guard<std::mutex> state_lock(state_msg_mutex);
     state_msg.RollTargetAngle = roll;
     state_msg.PitchTargetAngle = pitch;
     state_msg.YawTargetAngle = yaw;
@@ -583,7 +826,6 @@ void AquaHWPlugin::reset_world(const std_msgs::Time::ConstPtr &msg){
    ROS_INFO("Resetting simulation");
    world->SetPaused(true);
    // add small random noise to the initial state
-   auto base_link = model->GetLink("aqua_base");
 #ifdef ROS_MELODIC
    auto p0 = base_link->InitialRelativePose();
    auto p = ignition::math::Pose3d(p0);
@@ -645,13 +887,8 @@ bool AquaHWPlugin::step_simulation(aquacore::StepSimulation::Request  &req, aqua
 { 
     if (_debug_print)
         ROS_INFO("Stepping simulation for [%lf] seconds",req.duration);
-#ifdef ROS_MELODIC
-    int n_steps = std::floor(req.duration/(world->Physics()->GetMaxStepSize()));
-#else
-    int n_steps = std::floor(req.duration/(world->GetPhysicsEngine()->GetMaxStepSize()));
-#endif
-    n_steps = (n_steps>0)?n_steps:1;
-    integrated_velocity.fill(0.0);
+    int n_steps = steps_for_duration(req.duration);
+    start_imu_preintegration();
     world->Step(n_steps);
     //world->StepWorld(n_steps);
     res.timestamp = ros::Time::now();
@@ -659,19 +896,17 @@ bool AquaHWPlugin::step_simulation(aquacore::StepSimulation::Request  &req, aqua
     res.integrated_velocity[0] = integrated_velocity[0];
     res.integrated_velocity[1] = integrated_velocity[1];
     res.integrated_velocity[2] = integrated_velocity[2];
+    get_imu_preintegration(res.imu_preintegration);
+    double joint_angles[NUM_LEGS];
+    read_joint_angles(joint_angles);
     for (int i=0; i<6; i++){
         res.amplitudes[i] = latest_periodic_leg_command.amplitudes[i];
         res.frequencies[i] = latest_periodic_leg_command.frequencies[i];
         res.leg_offsets[i] = latest_periodic_leg_command.leg_offsets[i];
         res.phase_offsets[i] = latest_periodic_leg_command.phase_offsets[i];
-        res.phase_offsets[i] = latest_periodic_leg_command.phase_offsets[i];
-#ifdef ROS_MELODIC
-        res.joint_angles[i] = model->GetJoint(JOINT_NAMES[i])->Position(1);
-#else
-        res.joint_angles[i] = model->GetJoint(JOINT_NAMES[i])->GetAngle(1).Radian();
-#endif
+        res.joint_angles[i] = joint_angles[i];
     }
-    state_pub.publish(state_msg);
+    state_pub.publish(current_state());
 
     return true;
 };
@@ -681,13 +916,8 @@ bool AquaHWPlugin::run_simulation_until_time(aquacore::RunSimulationUntilTime::R
     if (_debug_print)
         ROS_INFO_STREAM("Running simulation until "<<req.desired_time);
     double duration  = (req.desired_time - ros::Time::now()).toSec();
-#ifdef ROS_MELODIC
-    int n_steps = std::floor(duration/(world->Physics()->GetMaxStepSize()));
-#else
-    int n_steps = std::floor(duration/(world->GetPhysicsEngine()->GetMaxStepSize()));
-#endif
-    n_steps = (n_steps>0)?n_steps:1;
-    integrated_velocity.fill(0.0);
+    int n_steps = steps_for_duration(duration);
+    start_imu_preintegration();
     world->Step(n_steps);
     //world->StepWorld(n_steps);
 
@@ -696,22 +926,367 @@ bool AquaHWPlugin::run_simulation_until_time(aquacore::RunSimulationUntilTime::R
     res.integrated_velocity[0] = integrated_velocity[0];
     res.integrated_velocity[1] = integrated_velocity[1];
     res.integrated_velocity[2] = integrated_velocity[2];
+    get_imu_preintegration(res.imu_preintegration);
+    double joint_angles[NUM_LEGS];
+    read_joint_angles(joint_angles);
     for (int i=0; i<6; i++){
         res.amplitudes[i] = latest_periodic_leg_command.amplitudes[i];
         res.frequencies[i] = latest_periodic_leg_command.frequencies[i];
         res.leg_offsets[i] = latest_periodic_leg_command.leg_offsets[i];
         res.phase_offsets[i] = latest_periodic_leg_command.phase_offsets[i];
-        res.phase_offsets[i] = latest_periodic_leg_command.phase_offsets[i];
+        res.joint_angles[i] = joint_angles[i];
+    }
+
+    state_pub.publish(current_state());
+
+    return true;
+};
+
+int AquaHWPlugin::steps_for_duration(double duration)
+{
 #ifdef ROS_MELODIC
-        res.joint_angles[i] = model->GetJoint(JOINT_NAMES[i])->Position(1);
+    int n_steps = std::floor(duration/(world->Physics()->GetMaxStepSize()));
 #else
-        res.joint_angles[i] = model->GetJoint(JOINT_NAMES[i])->GetAngle(1).Radian();
+    int n_steps = std::floor(duration/(world->GetPhysicsEngine()->GetMaxStepSize()));
 #endif
+    return (n_steps>0)?n_steps:1;
+}
+
+// appends one row to the trajectory buffer, laid out as documented in StepSimulationBatch.srv
+void AquaHWPlugin::record_trajectory_sample()
+{
+    if ((trajectory_steps++) % trajectory_record_every != 0 || trajectory.size() + TRAJECTORY_STRIDE > trajectory.capacity())
+        return;
+
+    double row[TRAJECTORY_STRIDE];
+    double *r = row;
+    *r++ = current_time.Double();
+#ifdef ROS_MELODIC
+    auto pose = base_link->WorldPose();
+    auto lin_vel = base_link->WorldLinearVel();
+    auto ang_vel = base_link->WorldAngularVel();
+    auto body_ang_vel = base_link->RelativeAngularVel();
+    // an accelerometer measures the specific force, i.e. acceleration minus gravity
+    auto body_acc = base_link->RelativeLinearAccel() - pose.Rot().RotateVectorReverse(world->Gravity());
+    *r++ = pose.Pos().X(); *r++ = pose.Pos().Y(); *r++ = pose.Pos().Z();
+    *r++ = pose.Rot().X(); *r++ = pose.Rot().Y(); *r++ = pose.Rot().Z(); *r++ = pose.Rot().W();
+    *r++ = lin_vel.X(); *r++ = lin_vel.Y(); *r++ = lin_vel.Z();
+    *r++ = ang_vel.X(); *r++ = ang_vel.Y(); *r++ = ang_vel.Z();
+    *r++ = body_ang_vel.X(); *r++ = body_ang_vel.Y(); *r++ = body_ang_vel.Z();
+    *r++ = body_acc.X(); *r++ = body_acc.Y(); *r++ = body_acc.Z();
+#else
+    auto pose = base_link->GetWorldPose();
+    auto lin_vel = base_link->GetWorldLinearVel();
+    auto ang_vel = base_link->GetWorldAngularVel();
+    auto body_ang_vel = base_link->GetRelativeAngularVel();
+    // an accelerometer measures the specific force, i.e. acceleration minus gravity
+    auto body_acc = base_link->GetRelativeLinearAccel() - pose.rot.RotateVectorReverse(world->GetPhysicsEngine()->GetGravity());
+    *r++ = pose.pos.x; *r++ = pose.pos.y; *r++ = pose.pos.z;
+    *r++ = pose.rot.x; *r++ = pose.rot.y; *r++ = pose.rot.z; *r++ = pose.rot.w;
+    *r++ = lin_vel.x; *r++ = lin_vel.y; *r++ = lin_vel.z;
+    *r++ = ang_vel.x; *r++ = ang_vel.y; *r++ = ang_vel.z;
+    *r++ = body_ang_vel.x; *r++ = body_ang_vel.y; *r++ = body_ang_vel.z;
+    *r++ = body_acc.x; *r++ = body_acc.y; *r++ = body_acc.z;
+#endif
+    double joint_angles[NUM_LEGS];
+    read_joint_angles(joint_angles);
+    for (int i=0; i<NUM_LEGS; i++){
+        *r++ = joint_angles[i];
+    }
+#ifdef ROS_MELODIC
+    *r++ = surface_level - depth_sensor_link->WorldPose().Pos().Z();
+#else
+    *r++ = surface_level - depth_sensor_link->GetWorldPose().pos.z;
+#endif
+    trajectory.insert(trajectory.end(), row, row + TRAJECTORY_STRIDE);
+}
+
+bool AquaHWPlugin::step_simulation_batch(aquacore::StepSimulationBatch::Request  &req, aquacore::StepSimulationBatch::Response &res)
+{
+    if (req.commands.size() != req.durations.size()){
+        ROS_ERROR("step_simulation_batch: got %lu commands but %lu durations", req.commands.size(), req.durations.size());
+        return false;
+    }
+    if (!periodic_leg_command_active){
+        // the hover gait computes its own leg command every tick and would ignore the batch
+        ROS_ERROR("step_simulation_batch: requires the flexible-sine gait (see set_gait)");
+        return false;
+    }
+    if (_debug_print)
+        ROS_INFO("Stepping simulation through [%lu] leg commands",req.commands.size());
+
+    // size the trajectory buffer up front
+    std::vector<int> n_steps(req.commands.size());
+    uint64_t total_steps = 0;
+    for (size_t c=0; c<req.commands.size(); c++){
+        n_steps[c] = steps_for_duration(req.durations[c]);
+        total_steps += n_steps[c];
+    }
+    trajectory_record_every = (req.record_every>1)?req.record_every:1;
+    trajectory_steps = 0;
+    trajectory.clear();
+    trajectory.reserve((total_steps/trajectory_record_every + 1)*TRAJECTORY_STRIDE);
+    res.command_boundaries.resize(req.commands.size());
+
+    start_imu_preintegration();
+    trajectory_recording = true;
+    for (size_t c=0; c<req.commands.size(); c++){
+        const aquacore::PeriodicLegCommand &cmd = req.commands[c];
+        {
+            std::lock_guard<std::mutex> controller_lock(controller_mutex);
+            for (int i=0; i<6; i++){
+                latest_periodic_leg_command.amplitudes[i] = cmd.amplitudes[i];
+                latest_periodic_leg_command.frequencies[i] = cmd.frequencies[i];
+                latest_periodic_leg_command.leg_offsets[i] = cmd.leg_offsets[i];
+                latest_periodic_leg_command.phase_offsets[i] = cmd.phase_offsets[i];
+            }
+        }
+        keepalive(true);
+        res.command_boundaries[c] = trajectory.size()/TRAJECTORY_STRIDE;
+        world->Step(n_steps[c]);
     }
+    trajectory_recording = false;
 
-    state_pub.publish(state_msg);
+    res.timestamp = ros::Time::now();
+    res.stride = TRAJECTORY_STRIDE;
+    res.n_samples = trajectory.size()/TRAJECTORY_STRIDE;
+    res.trajectory.swap(trajectory);
+
+    state_pub.publish(current_state());
 
     return true;
 };
 
+// per-link state stored in episode snapshots: world pose (position, quaternion x,y,z,w) and CoG twist
+struct LinkSnapshot{
+    double pose[7];
+    double lin_vel[3];
+    double ang_vel[3];
+};
+
+bool AquaHWPlugin::save_episode_snapshot(aquacore::SaveEpisodeSnapshot::Request  &req, aquacore::SaveEpisodeSnapshot::Response &res)
+{
+    res.success = false;
+    bool was_paused = world->IsPaused();
+    world->SetPaused(true);
+    {
+#ifdef ROS_MELODIC
+        boost::recursive_mutex::scoped_lock physics_update_lock(*world->Physics()->GetPhysicsUpdateMutex());
+#else
+        boost::recursive_mutex::scoped_lock physics_update_lock(*world->GetPhysicsEngine()->GetPhysicsUpdateMutex());
+#endif
+        std::lock_guard<std::mutex> physics_lock(channel->physics_mutex);
+        std::lock_guard<std::mutex> controller_lock(controller_mutex);
+        // choreographies are loaded from files and not serialized, so a snapshot could not resume one
+        if (playing_choreography || std::atomic_load(&choreography)){
+            ROS_ERROR("save_episode_snapshot: cannot save while a choreography is playing");
+            world->SetPaused(was_paused);
+            return true;
+        }
+        SnapshotWriter writer(res.data);
+
+        writer.write(EPISODE_SNAPSHOT_MAGIC);
+        writer.write(EPISODE_SNAPSHOT_VERSION);
+        writer.write(current_time.Double());
+
+        // robot state
+        auto links = model->GetLinks();
+        auto joints = model->GetJoints();
+        writer.write((uint32_t)links.size());
+        for (auto &link : links){
+            LinkSnapshot ls;
+#ifdef ROS_MELODIC
+            auto pose = link->WorldPose();
+            auto lin_vel = link->WorldCoGLinearVel();
+            auto ang_vel = link->WorldAngularVel();
+            double values[13] = {pose.Pos().X(), pose.Pos().Y(), pose.Pos().Z(),
+                                 pose.Rot().X(), pose.Rot().Y(), pose.Rot().Z(), pose.Rot().W(),
+                                 lin_vel.X(), lin_vel.Y(), lin_vel.Z(), ang_vel.X(), ang_vel.Y(), ang_vel.Z()};
+#else
+            auto pose = link->GetWorldPose();
+            auto lin_vel = link->GetWorldCoGLinearVel();
+            auto ang_vel = link->GetWorldAngularVel();
+            double values[13] = {pose.pos.x, pose.pos.y, pose.pos.z,
+                                 pose.rot.x, pose.rot.y, pose.rot.z, pose.rot.w,
+                                 lin_vel.x, lin_vel.y, lin_vel.z, ang_vel.x, ang_vel.y, ang_vel.z};
+#endif
+            std::copy(values, values + 7, ls.pose);
+            std::copy(values + 7, values + 10, ls.lin_vel);
+            std::copy(values + 10, values + 13, ls.ang_vel);
+            writer.write(ls);
+        }
+        writer.write((uint32_t)joints.size());
+        for (auto &joint : joints){
+#ifdef ROS_MELODIC
+            writer.write(joint->Position(0));
+#else
+            writer.write(joint->GetAngle(0).Radian());
+#endif
+            writer.write(joint->GetVelocity(0));
+        }
+
+        // plugin state
+        writer.write(state);
+        writer.write(periodic_leg_command_active);
+        writer.write(latest_periodic_leg_command);
+        writer.write(integrated_velocity.data(), integrated_velocity.size());
+        writer.write((current_time - last_controller_update_time).Double());
+        UnderwaterSwimmerGaitState_t gait_state;
+        uwsg_controller.saveState(gait_state);
+        writer.write(gait_state);
+        ImuPreintegratorState imu_state;
+        {
+            std::lock_guard<std::mutex> imu_lock(imu_mutex);
+            imu_preintegrator.saveState(imu_state);
+        }
+        writer.write(imu_state);
+
+        uint8_t has_hydrodynamics = (bool)channel->save_hydrodynamics_state;
+        writer.write(has_hydrodynamics);
+        if (has_hydrodynamics)
+            channel->save_hydrodynamics_state(writer);
+        res.success = true;
+    }
+    world->SetPaused(was_paused);
+
+    if (_debug_print)
+        ROS_INFO("Saved episode snapshot of [%lu] bytes", res.data.size());
+    return true;
+}
+
+bool AquaHWPlugin::restore_episode_snapshot(aquacore::RestoreEpisodeSnapshot::Request  &req, aquacore::RestoreEpisodeSnapshot::Response &res)
+{
+    res.success = false;
+    bool was_paused = world->IsPaused();
+    world->SetPaused(true);
+    {
+        // no physics update nor plugin update can run while the state is being overwritten
+#ifdef ROS_MELODIC
+        boost::recursive_mutex::scoped_lock physics_update_lock(*world->Physics()->GetPhysicsUpdateMutex());
+#else
+        boost::recursive_mutex::scoped_lock physics_update_lock(*world->GetPhysicsEngine()->GetPhysicsUpdateMutex());
+#endif
+        std::lock_guard<std::mutex> physics_lock(channel->physics_mutex);
+        std::lock_guard<std::mutex> controller_lock(controller_mutex);
+        SnapshotReader reader(req.data.data(), req.data.size());
+
+        // read and validate everything before touching the simulation
+        uint32_t magic = 0, version = 0, n_links = 0, n_joints = 0;
+        double sim_time;
+        auto links = model->GetLinks();
+        auto joints = model->GetJoints();
+        if (!(reader.read(magic) && reader.read(version) && reader.read(sim_time) && reader.read(n_links)) ||
+            magic != EPISODE_SNAPSHOT_MAGIC || version != EPISODE_SNAPSHOT_VERSION || n_links != links.size()){
+            ROS_ERROR("restore_episode_snapshot: snapshot does not match this model or simulator version");
+            world->SetPaused(was_paused);
+            return true;
+        }
+        std::vector<LinkSnapshot> link_states(n_links);
+        std::vector<double> joint_states;
+        int saved_state;
+        bool saved_periodic_leg_command_active;
+        PeriodicLegState_t saved_periodic_leg_command;
+        boost::array<double,NUM_LEGS> saved_integrated_velocity;
+        double controller_update_age;
+        UnderwaterSwimmerGaitState_t gait_state;
+        ImuPreintegratorState imu_state;
+        uint8_t has_hydrodynamics = 0;
+        bool ok = reader.read(link_states.data(), n_links) && reader.read(n_joints) && n_joints == joints.size();
+        if (ok){
+            joint_states.resize(2*n_joints);
+            ok = reader.read(joint_states.data(), joint_states.size()) &&
+                 reader.read(saved_state) && reader.read(saved_periodic_leg_command_active) &&
+                 reader.read(saved_periodic_leg_command) &&
+                 reader.read(saved_integrated_velocity.data(), saved_integrated_velocity.size()) &&
+                 reader.read(controller_update_age) && reader.read(gait_state) &&
+                 reader.read(imu_state) && reader.read(has_hydrodynamics);
+        }
+        // the hydrodynamics plugin validates its own section before applying it
+        if (ok && has_hydrodynamics){
+            ok = channel->restore_hydrodynamics_state && channel->restore_hydrodynamics_state(reader);
+        }
+        if (!ok || !reader.done()){
+            ROS_ERROR("restore_episode_snapshot: truncated or corrupted snapshot");
+            world->SetPaused(was_paused);
+            return true;
+        }
+
+        // simulation time first, so that the gait controller's clock picks it up
+        current_time = gazebo::common::Time(sim_time);
+        world->SetSimTime(current_time);
+
+        // joints first, since setting joint positions moves their child links
+        for (size_t i=0; i<joints.size(); i++){
+            joints[i]->SetPosition(0, joint_states[2*i]);
+            joints[i]->SetVelocity(0, joint_states[2*i+1]);
+        }
+        for (size_t i=0; i<links.size(); i++){
+            const LinkSnapshot &ls = link_states[i];
+#ifdef ROS_MELODIC
+            links[i]->SetWorldPose(ignition::math::Pose3d(ls.pose[0], ls.pose[1], ls.pose[2], ls.pose[6], ls.pose[3], ls.pose[4], ls.pose[5]));
+            links[i]->SetLinearVel(ignition::math::Vector3d(ls.lin_vel[0], ls.lin_vel[1], ls.lin_vel[2]));
+            links[i]->SetAngularVel(ignition::math::Vector3d(ls.ang_vel[0], ls.ang_vel[1], ls.ang_vel[2]));
+#else
+            links[i]->SetWorldPose(gazebo::math::Pose(gazebo::math::Vector3(ls.pose[0], ls.pose[1], ls.pose[2]),
+                                                      gazebo::math::Quaternion(ls.pose[6], ls.pose[3], ls.pose[4], ls.pose[5])));
+            links[i]->SetLinearVel(gazebo::math::Vector3(ls.lin_vel[0], ls.lin_vel[1], ls.lin_vel[2]));
+            links[i]->SetAngularVel(gazebo::math::Vector3(ls.ang_vel[0], ls.ang_vel[1], ls.ang_vel[2]));
+#endif
+        }
+
+        state = saved_state;
+        periodic_leg_command_active = saved_periodic_leg_command_active;
+        latest_periodic_leg_command = saved_periodic_leg_command;
+        integrated_velocity = saved_integrated_velocity;
+        last_controller_update_time = current_time - gazebo::common::Time(controller_update_age);
+        uwsg_controller.restoreState(gait_state);
+        // the gait timestamps are now relative to the current clock, whichever way it moved
+        last_controller_time = -1;
+        last_gait_update_time = controller_time();
+        {
+            std::lock_guard<std::mutex> imu_lock(imu_mutex);
+            imu_preintegrator.restoreState(imu_state);
+        }
+
+        // snapshots are only taken outside of choreography playback
+        std::atomic_store(&choreography, std::shared_ptr<const LegChoreography>());
+        playing_choreography.reset();
+        gait_suspended = false;
+        res.success = true;
+    }
+    world->SetPaused(was_paused);
+    keepalive(true);
+
+    if (_debug_print)
+        ROS_INFO("Restored episode snapshot of [%lu] bytes", req.data.size());
+    return true;
+}
+
+bool AquaHWPlugin::play_choreography(aquacore::PlayChoreography::Request  &req, aquacore::PlayChoreography::Response &res){
+    if (req.path.empty()){
+        std::atomic_store(&choreography, std::shared_ptr<const LegChoreography>());
+        res.success = true;
+        res.message = "choreography stopped";
+        return true;
+    }
+
+    // compile outside of the controller, which only ever sees complete tables
+    std::shared_ptr<LegChoreography> compiled = std::make_shared<LegChoreography>();
+    std::string error;
+    if (!compiled->load(req.path, error)){
+        ROS_WARN_STREAM("play_choreography: " << error);
+        res.success = false;
+        res.message = error;
+        return true;
+    }
+    compiled->setLoop(req.loop);
+    compiled->setTimeScale(req.time_scale);
+
+    res.duration = compiled->getDuration();
+    std::atomic_store(&choreography, std::shared_ptr<const LegChoreography>(compiled));
+    res.success = true;
+    res.message = "playing " + req.path;
+    return true;
+}
+
 GZ_REGISTER_MODEL_PLUGIN(AquaHWPlugin);
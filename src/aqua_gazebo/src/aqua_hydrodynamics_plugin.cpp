@@ -453,6 +453,7 @@ void AquaHydrodynamicsPlugin::Load(
     ROS_INFO("Loading the Aqua Hydrodynamics plugin");
     model = _parent;
     robot_namespace.clear();
+    channel = AquaModelChannel::Get(model->GetScopedName());
     target_angles.fill(0.0);
     frequency_cmd.fill(0.0);
     amplitude_cmd.fill(0.0);
@@ -541,10 +542,56 @@ void AquaHydrodynamicsPlugin::Load(
     initialPose = base_link->GetWorldCoGPose().Ign();
     current_pose = base_link->GetWorldPose().Ign();
 #endif
+
+    // let the hardware emulator include our state in its episode snapshots
+    channel->save_hydrodynamics_state = std::bind(&AquaHydrodynamicsPlugin::SaveState, this, std::placeholders::_1);
+    channel->restore_hydrodynamics_state = std::bind(&AquaHydrodynamicsPlugin::RestoreState, this, std::placeholders::_1);
+}
+
+void AquaHydrodynamicsPlugin::SaveState(SnapshotWriter &writer){
+    writer.write(last_update_time.Double());
+    writer.write(dist_force.data(), 3);
+    writer.write(prev_vel.data(), 3);
+    writer.write(target_angles.data(), NUM_LEGS);
+    writer.write(frequency_cmd.data(), NUM_LEGS);
+    writer.write(amplitude_cmd.data(), NUM_LEGS);
+    writer.write(leg_offsets_cmd.data(), NUM_LEGS);
+    writer.write(phase_offsets_cmd.data(), NUM_LEGS);
+    for (size_t i=0;i<NUM_LEGS;++i) {
+        double p_err, i_err;
+        pid[i].GetState(p_err, i_err);
+        writer.write(p_err);
+        writer.write(i_err);
+    }
+}
+
+bool AquaHydrodynamicsPlugin::RestoreState(SnapshotReader &reader){
+    double last_update, dist[3], vel[3], pid_errors[2*NUM_LEGS];
+    boost::array<double,NUM_LEGS> targets, freqs, ampls, offsets, phases;
+    if (!(reader.read(last_update) && reader.read(dist, 3) && reader.read(vel, 3) &&
+          reader.read(targets.data(), NUM_LEGS) && reader.read(freqs.data(), NUM_LEGS) &&
+          reader.read(ampls.data(), NUM_LEGS) && reader.read(offsets.data(), NUM_LEGS) &&
+          reader.read(phases.data(), NUM_LEGS) && reader.read(pid_errors, 2*NUM_LEGS))){
+        return false;
+    }
+
+    last_update_time = current_time = gazebo::common::Time(last_update);
+    dist_force = Eigen::Vector3d(dist[0], dist[1], dist[2]);
+    prev_vel = Eigen::Vector3d(vel[0], vel[1], vel[2]);
+    target_angles = targets;
+    frequency_cmd = freqs;
+    amplitude_cmd = ampls;
+    leg_offsets_cmd = offsets;
+    phase_offsets_cmd = phases;
+    for (size_t i=0;i<NUM_LEGS;++i) {
+        pid[i].SetState(pid_errors[2*i], pid_errors[2*i+1]);
+    }
+    return true;
 }
 
 
 void AquaHydrodynamicsPlugin::OnUpdate(const gazebo::common::UpdateInfo & info){
+    std::lock_guard<std::mutex> physics_lock(channel->physics_mutex);
 #ifdef ROS_MELODIC
     // get current pose
     current_pose = base_link->WorldPose();
@@ -650,6 +697,16 @@ void AquaHydrodynamicsPlugin::OnUpdate(const gazebo::common::UpdateInfo & info){
     double dt = current_time.Double() - last_update_time.Double();
     last_update_time = current_time;
 
+    // pick up the latest leg command from the hardware emulator, if there is a new one
+    if (channel->leg_command.update()){
+        const SharedLegCommand &cmd = channel->leg_command.read();
+        std::copy(cmd.target_angles, cmd.target_angles + NUM_LEGS, target_angles.begin());
+        std::copy(cmd.frequencies, cmd.frequencies + NUM_LEGS, frequency_cmd.begin());
+        std::copy(cmd.amplitudes, cmd.amplitudes + NUM_LEGS, amplitude_cmd.begin());
+        std::copy(cmd.leg_offsets, cmd.leg_offsets + NUM_LEGS, leg_offsets_cmd.begin());
+        std::copy(cmd.phase_offsets, cmd.phase_offsets + NUM_LEGS, phase_offsets_cmd.begin());
+    }
+
     // get the motor commands here!
     for (size_t i=0;i<NUM_LEGS;++i) {
 #ifdef ROS_MELODIC
@@ -689,7 +746,6 @@ void AquaHydrodynamicsPlugin::OnUpdate(const gazebo::common::UpdateInfo & info){
         //---------------------------------- MOTOR CONTROLLER --------------------------------------//
         double error = 0;
         
-        pid[i].SetCmd(target_angles[i]);
         error = joint_angle - target_angles[i];
 
         // limit the error to be between -180 and 180
@@ -0,0 +1,314 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+/**
+ * simulation_farm: runs N independent headless simulations in parallel and
+ * exposes them as a single step_simulation_batch service.
+ *
+ * Every worker is a separate roslaunch of headless.launch, with its own ROS
+ * master and gazebo master ports so that the simulations are fully isolated.
+ * Since a roscpp process can only talk to one master, each worker also gets a
+ * client process connected to its master. The farm node (connected to the
+ * usual master) hands batch requests to the clients round-robin through
+ * anonymous shared memory, and every client appends the trajectories it gets
+ * back to a shared-memory ring (see farm_ring.h) that learners can mmap.
+ *
+ * usage: rosrun aqua_gazebo simulation_farm [-n workers] [-p base_port] [-r ring_rows] [-s ring_name]
+ */
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/sync/interprocess_condition.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+
+#include <ros/ros.h>
+#include <aquacore/StepSimulationBatch.h>
+#include <aqua_gazebo/farm_ring.h>
+
+namespace bip = boost::interprocess;
+
+// request/response mailbox shared between the farm node and one worker client
+struct WorkerSlot
+{
+    enum {IDLE, REQUEST, RESPONSE, FAILED, EXIT};
+
+    bip::interprocess_mutex mutex;
+    bip::interprocess_condition cond;
+    int state;
+    uint64_t sequence;
+    uint32_t size;
+
+    uint8_t *data(){ return reinterpret_cast<uint8_t*>(this + 1); }
+};
+
+struct FarmOptions
+{
+    int n_workers;
+    int base_port;
+    uint64_t ring_rows;
+    uint32_t slot_bytes;
+    std::string ring_name;
+};
+
+static std::string master_uri(int port){
+    return "http://localhost:" + std::to_string(port);
+}
+
+static WorkerSlot* worker_slot(uint8_t *slots, const FarmOptions &options, int i){
+    return reinterpret_cast<WorkerSlot*>(slots + (size_t)i*(sizeof(WorkerSlot) + options.slot_bytes));
+}
+
+// runs headless.launch against its own ROS master (started by roslaunch) and gazebo master
+static pid_t start_worker_simulation(int i, const FarmOptions &options){
+    pid_t pid = fork();
+    if (pid == 0){
+        // own process group, so that the whole roslaunch tree can be signalled at once
+        setpgid(0, 0);
+        int ros_port = options.base_port + 2*i;
+        setenv("ROS_MASTER_URI", master_uri(ros_port).c_str(), 1);
+        setenv("GAZEBO_MASTER_URI", master_uri(ros_port + 1).c_str(), 1);
+        std::string port = std::to_string(ros_port);
+        execlp("roslaunch", "roslaunch", "-p", port.c_str(), "aqua_gazebo", "headless.launch", (char*)NULL);
+        perror("simulation_farm: could not exec roslaunch");
+        _exit(1);
+    }
+    return pid;
+}
+
+static void append_to_ring(FarmRingHeader *ring, int worker, uint64_t sequence, const aquacore::StepSimulationBatch::Response &res){
+    if (res.stride + FARM_RING_ROW_HEADER != ring->stride)
+        return;
+    bip::scoped_lock<bip::interprocess_mutex> lock(ring->write_mutex);
+    uint64_t index = ring->write_index.load(std::memory_order_relaxed);
+    for (uint32_t k=0; k<res.n_samples; k++, index++){
+        double *row = ring->rows() + (index % ring->capacity)*ring->stride;
+        row[0] = worker;
+        row[1] = sequence;
+        std::memcpy(row + FARM_RING_ROW_HEADER, &res.trajectory[(size_t)k*res.stride], res.stride*sizeof(double));
+    }
+    ring->write_index.store(index, std::memory_order_release);
+}
+
+// forwards the requests posted in its slot to the step_simulation_batch service of one worker
+static int run_worker_client(int i, const FarmOptions &options, WorkerSlot *slot, FarmRingHeader *ring){
+    ros::M_string remappings;
+    remappings["__master"] = master_uri(options.base_port + 2*i);
+    ros::init(remappings, "simulation_farm_client_" + std::to_string(i), ros::init_options::NoSigintHandler);
+    ros::NodeHandle nh;
+    // the simulation may still be starting up
+    ros::service::waitForService("/aqua/step_simulation_batch");
+    ros::ServiceClient client = nh.serviceClient<aquacore::StepSimulationBatch>("/aqua/step_simulation_batch", true);
+
+    while (true){
+        aquacore::StepSimulationBatch srv;
+        uint64_t sequence;
+        {
+            bip::scoped_lock<bip::interprocess_mutex> lock(slot->mutex);
+            while (slot->state != WorkerSlot::REQUEST && slot->state != WorkerSlot::EXIT)
+                slot->cond.wait(lock);
+            if (slot->state == WorkerSlot::EXIT)
+                break;
+            ros::serialization::IStream stream(slot->data(), slot->size);
+            ros::serialization::deserialize(stream, srv.request);
+            sequence = slot->sequence;
+        }
+
+        // persistent connections are not re-established automatically
+        if (!client.isValid()){
+            client = nh.serviceClient<aquacore::StepSimulationBatch>("/aqua/step_simulation_batch", true);
+        }
+        bool ok = client.call(srv);
+        if (ok)
+            append_to_ring(ring, i, sequence, srv.response);
+
+        bip::scoped_lock<bip::interprocess_mutex> lock(slot->mutex);
+        uint32_t size = ros::serialization::serializationLength(srv.response);
+        if (ok && size <= options.slot_bytes){
+            ros::serialization::OStream stream(slot->data(), size);
+            ros::serialization::serialize(stream, srv.response);
+            slot->size = size;
+            slot->state = WorkerSlot::RESPONSE;
+        } else {
+            if (ok)
+                ROS_ERROR("simulation_farm: response of %u bytes does not fit in a worker slot", size);
+            slot->state = WorkerSlot::FAILED;
+        }
+        slot->cond.notify_all();
+    }
+    return 0;
+}
+
+class SimulationFarm
+{
+  public:
+    SimulationFarm(const FarmOptions &options, uint8_t *slots):
+        options(options), slots(slots), next_worker(0), next_sequence(0){
+        nh = ros::NodeHandle("aqua_farm");
+        step_simulation_batch_service = nh.advertiseService("step_simulation_batch", &SimulationFarm::step_simulation_batch, this);
+    }
+
+    bool step_simulation_batch(aquacore::StepSimulationBatch::Request  &req, aquacore::StepSimulationBatch::Response &res){
+        int i = next_worker++ % options.n_workers;
+        WorkerSlot *slot = worker_slot(slots, options, i);
+        uint32_t size = ros::serialization::serializationLength(req);
+        if (size > options.slot_bytes){
+            ROS_ERROR("simulation_farm: request of %u bytes does not fit in a worker slot", size);
+            return false;
+        }
+
+        bip::scoped_lock<bip::interprocess_mutex> lock(slot->mutex);
+        // wait for the previous request dispatched to this worker to be picked up by its caller
+        while (slot->state != WorkerSlot::IDLE)
+            slot->cond.wait(lock);
+        ros::serialization::OStream stream(slot->data(), size);
+        ros::serialization::serialize(stream, req);
+        slot->size = size;
+        slot->sequence = next_sequence++;
+        slot->state = WorkerSlot::REQUEST;
+        slot->cond.notify_all();
+
+        while (slot->state == WorkerSlot::REQUEST)
+            slot->cond.wait(lock);
+        bool ok = (slot->state == WorkerSlot::RESPONSE);
+        if (ok){
+            ros::serialization::IStream in(slot->data(), slot->size);
+            ros::serialization::deserialize(in, res);
+        }
+        slot->state = WorkerSlot::IDLE;
+        slot->cond.notify_all();
+        return ok;
+    }
+
+  private:
+    FarmOptions options;
+    uint8_t *slots;
+    std::atomic<unsigned int> next_worker;
+    std::atomic<uint64_t> next_sequence;
+    ros::NodeHandle nh;
+    ros::ServiceServer step_simulation_batch_service;
+};
+
+int main(int argc, char **argv){
+    FarmOptions options;
+    options.n_workers = std::max(1u, std::thread::hardware_concurrency());
+    options.base_port = 11400;
+    options.ring_rows = 1 << 18;
+    options.slot_bytes = 64 << 20;
+    options.ring_name = "aqua_farm_ring";
+    int opt;
+    while ((opt = getopt(argc, argv, "n:p:r:s:")) != -1){
+        switch (opt){
+            case 'n': options.n_workers = std::max(1, atoi(optarg)); break;
+            case 'p': options.base_port = atoi(optarg); break;
+            case 'r': options.ring_rows = std::max(1ll, atoll(optarg)); break;
+            case 's': options.ring_name = optarg; break;
+            default: break;
+        }
+    }
+
+    // everything shared with the children is set up before forking, and the farm node
+    // only initializes roscpp (which starts threads) after all children are running
+    size_t slots_size = options.n_workers*(sizeof(WorkerSlot) + options.slot_bytes);
+    uint8_t *slots = (uint8_t*) mmap(NULL, slots_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (slots == MAP_FAILED){
+        perror("simulation_farm: could not map worker slots");
+        return 1;
+    }
+    for (int i=0; i<options.n_workers; i++){
+        WorkerSlot *slot = new (worker_slot(slots, options, i)) WorkerSlot();
+        slot->state = WorkerSlot::IDLE;
+        slot->sequence = 0;
+        slot->size = 0;
+    }
+
+    bip::shared_memory_object::remove(options.ring_name.c_str());
+    bip::shared_memory_object ring_shm(bip::create_only, options.ring_name.c_str(), bip::read_write);
+    uint32_t ring_stride = TRAJECTORY_STRIDE + FARM_RING_ROW_HEADER;
+    ring_shm.truncate(sizeof(FarmRingHeader) + options.ring_rows*ring_stride*sizeof(double));
+    bip::mapped_region ring_region(ring_shm, bip::read_write);
+    FarmRingHeader *ring = new (ring_region.get_address()) FarmRingHeader();
+    ring->stride = ring_stride;
+    ring->capacity = options.ring_rows;
+    ring->write_index = 0;
+    ring->magic = FARM_RING_MAGIC;
+
+    std::vector<pid_t> children;
+    for (int i=0; i<options.n_workers; i++){
+        children.push_back(start_worker_simulation(i, options));
+        pid_t pid = fork();
+        if (pid == 0){
+            _exit(run_worker_client(i, options, worker_slot(slots, options, i), ring));
+        }
+        children.push_back(pid);
+    }
+
+    ros::init(argc, argv, "simulation_farm");
+    {
+        SimulationFarm farm(options, slots);
+        ROS_INFO("Simulation farm running %d workers on ports %d-%d, trajectories in /dev/shm/%s",
+                 options.n_workers, options.base_port, options.base_port + 2*options.n_workers - 1, options.ring_name.c_str());
+        // one thread per worker, so that concurrent callers keep all the simulations busy
+        ros::MultiThreadedSpinner spinner(options.n_workers);
+        spinner.spin();
+    }
+
+    // shut down the clients and the simulations
+    for (int i=0; i<options.n_workers; i++){
+        WorkerSlot *slot = worker_slot(slots, options, i);
+        bip::scoped_lock<bip::interprocess_mutex> lock(slot->mutex);
+        slot->state = WorkerSlot::EXIT;
+        slot->cond.notify_all();
+    }
+    for (size_t c=0; c<children.size(); c+=2){
+        kill(-children[c], SIGINT);
+    }
+    for (pid_t pid : children){
+        waitpid(pid, NULL, 0);
+    }
+    bip::shared_memory_object::remove(options.ring_name.c_str());
+    munmap(slots, slots_size);
+    return 0;
+}
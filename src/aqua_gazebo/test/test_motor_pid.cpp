@@ -0,0 +1,119 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <gtest/gtest.h>
+#include <aqua_gazebo/motor_pid.h>
+#include <aqua_gazebo/episode_snapshot.h>
+#include <cmath>
+#include <vector>
+
+// A flipper joint driven by the controller: unit inertia with viscous damping,
+// tracking a sinusoidal target at the physics rate of the simulation
+struct Joint
+{
+    double angle = 0.0, vel = 0.0;
+
+    double step(MotorPID &pid, double t, double dt){
+        double target = 0.8*std::sin(2*M_PI*2.5*t);
+        double torque = pid.Update(angle - target, dt);
+        vel += (torque - 0.5*vel)*dt;
+        angle += vel*dt;
+        return torque;
+    }
+};
+
+static void checkRestore(double p_gain, double i_gain, double d_gain){
+    const double dt = 0.001;
+    const int save_step = 1500, steps = 3000;
+
+    MotorPID pid;
+    pid.Init(p_gain, i_gain, d_gain, 20.0, -20.0, 20.0, -20.0);
+    Joint joint;
+    std::vector<uint8_t> snapshot;
+    Joint saved_joint;
+    std::vector<double> torques;
+    for (int k = 0; k < steps; ++k) {
+        if (k == save_step) {
+            SnapshotWriter writer(snapshot);
+            double p_err, i_err;
+            pid.GetState(p_err, i_err);
+            writer.write(p_err);
+            writer.write(i_err);
+            saved_joint = joint;
+        }
+        torques.push_back(joint.step(pid, k*dt, dt));
+    }
+
+    // a controller with unrelated history, restored from the snapshot
+    MotorPID restored;
+    restored.Init(p_gain, i_gain, d_gain, 20.0, -20.0, 20.0, -20.0);
+    restored.Update(5.0, 0.1);
+    SnapshotReader reader(snapshot.data(), snapshot.size());
+    double p_err, i_err;
+    ASSERT_TRUE(reader.read(p_err) && reader.read(i_err) && reader.done());
+    restored.SetState(p_err, i_err);
+
+    Joint joint2 = saved_joint;
+    for (int k = save_step; k < steps; ++k) {
+        ASSERT_EQ(torques[k], joint2.step(restored, k*dt, dt)) << "step " << k;
+    }
+}
+
+TEST(MotorPID, RestoreMatchesUninterruptedRun){
+    // gains of aqua_plugins.urdf.xacro
+    checkRestore(3.0, 0.25, 0.0);
+}
+
+TEST(MotorPID, RestoreWithoutIntegralGain){
+    checkRestore(3.0, 0.0, 0.0);
+}
+
+TEST(MotorPID, RestoreWithDerivativeGainAndSaturatedIntegral){
+    // the integral term saturates at its +-20 clamp before the snapshot
+    checkRestore(3.0, 400.0, 0.05);
+}
+
+TEST(MotorPID, IntegralClamp){
+    MotorPID pid;
+    pid.Init(0.0, 1.0, 0.0, 20.0, -20.0, 20.0, -20.0);
+    for (int k = 0; k < 100; ++k)
+        pid.Update(1.0, 1.0);
+    double p_err, i_err;
+    pid.GetState(p_err, i_err);
+    EXPECT_EQ(20.0, i_err);
+    EXPECT_EQ(-20.0, pid.GetCmd());
+}
+
+int main(int argc, char **argv){
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
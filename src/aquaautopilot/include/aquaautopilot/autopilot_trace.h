@@ -0,0 +1,181 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef AQUAAUTOPILOT_AUTOPILOT_TRACE_H
+#define AQUAAUTOPILOT_AUTOPILOT_TRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Binary trace of the autopilot internals, one record per update, written
+ * into a ring buffer in POSIX shared memory. The ring is allocated once when
+ * the trace is opened; writing a record is a copy and a few atomic stores,
+ * with no formatting, allocation or system call. An external tool
+ * (autopilot_trace_dump) maps the same region and reads records behind the
+ * writer; it never blocks it.
+ */
+
+// Why a record was written with a zero command, or AP_TRACE_ACTIVE
+enum AutopilotTraceStatus
+{
+  AP_TRACE_ACTIVE = 0,
+  AP_TRACE_NO_VELOCITY,
+  AP_TRACE_NO_TARGET,
+  AP_TRACE_NO_DEPTH,
+  AP_TRACE_NO_ORIENTATION,
+  AP_TRACE_UNSUPPORTED_MODE,
+  AP_TRACE_SENSOR_TIMEOUT     // sensor-triggered updates stopped (see ~control_trigger)
+};
+
+struct AutopilotTraceRecord
+{
+  double stamp;               // ros::Time of the update (s)
+  int32_t mode;               // aquacore::AutopilotModes
+  int32_t status;             // AutopilotTraceStatus
+  // target_rpy, current_rpy, error_rpy and depth_error are NaN unless status is AP_TRACE_ACTIVE
+  float target_rpy[3];        // target angles in global frame (deg)
+  float current_rpy[3];       // robot angles in global frame (deg)
+  float error_rpy[3];         // angle errors in IMU frame (rad)
+  float command[5];           // published roll, pitch, yaw, speed, heave
+  float depth;                // current depth (m)
+  float depth_error;          // depth target - current depth (m)
+  float filtered_depth_derivative;
+};
+
+struct AutopilotTraceSlot
+{
+  // 2*i+1 while record i is being written into this slot, 2*i+2 once complete
+  std::atomic<uint64_t> seq;
+  AutopilotTraceRecord record;
+};
+
+struct AutopilotTraceHeader
+{
+  static const uint32_t MAGIC = 0x52545041; // "APTR"
+  static const uint32_t VERSION = 1;
+
+  uint32_t magic;
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t capacity;
+  std::atomic<uint64_t> head; // number of records written so far
+};
+
+inline size_t autopilotTraceSize(uint32_t capacity)
+{
+  return sizeof(AutopilotTraceHeader) + capacity * sizeof(AutopilotTraceSlot);
+}
+
+inline AutopilotTraceSlot* autopilotTraceSlots(AutopilotTraceHeader* header)
+{
+  return reinterpret_cast<AutopilotTraceSlot*>(header + 1);
+}
+
+// Writer side (single writer)
+class AutopilotTrace
+{
+public:
+  AutopilotTrace() : header_(NULL), slots_(NULL), size_(0) {}
+  ~AutopilotTrace() { close(); }
+
+  // Creates (or recreates) the shared memory region name, e.g. "/aquaautopilot_trace"
+  bool open(const std::string& name, uint32_t capacity)
+  {
+    close();
+    if (capacity == 0)
+      return false;
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0)
+      return false;
+    size_t size = autopilotTraceSize(capacity);
+    if (ftruncate(fd, size) != 0)
+    {
+      ::close(fd);
+      return false;
+    }
+    void* mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED)
+      return false;
+    memset(mem, 0, size);
+
+    header_ = static_cast<AutopilotTraceHeader*>(mem);
+    slots_ = autopilotTraceSlots(header_);
+    size_ = size;
+    header_->record_size = sizeof(AutopilotTraceRecord);
+    header_->capacity = capacity;
+    header_->version = AutopilotTraceHeader::VERSION;
+    header_->head.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = AutopilotTraceHeader::MAGIC; // readers wait for this
+    return true;
+  }
+
+  void close()
+  {
+    if (header_)
+      munmap(header_, size_);
+    header_ = NULL;
+    slots_ = NULL;
+    size_ = 0;
+  }
+
+  bool isOpen() const { return header_ != NULL; }
+
+  void write(const AutopilotTraceRecord& record)
+  {
+    if (!header_)
+      return;
+    uint64_t i = header_->head.load(std::memory_order_relaxed);
+    AutopilotTraceSlot& slot = slots_[i % header_->capacity];
+    slot.seq.store(2*i + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.record = record;
+    slot.seq.store(2*i + 2, std::memory_order_release);
+    header_->head.store(i + 1, std::memory_order_release);
+  }
+
+private:
+  AutopilotTraceHeader* header_;
+  AutopilotTraceSlot* slots_;
+  size_t size_;
+};
+
+#endif // AQUAAUTOPILOT_AUTOPILOT_TRACE_H
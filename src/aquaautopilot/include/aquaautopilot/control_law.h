@@ -0,0 +1,142 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef AQUAAUTOPILOT_CONTROL_LAW_H
+#define AQUAAUTOPILOT_CONTROL_LAW_H
+
+/**
+ * The control law of the 3D autopilot (LocalAutopilot), without ROS, so that
+ * it can also run offline against a model or recorded data (autopilot_tune).
+ *
+ * One call of computeControl() is one autopilot update. It takes the target
+ * and current orientation, the depth and the filtered rates. It returns the
+ * roll, pitch, yaw, speed and heave command and the values reported in
+ * UberpilotStatus.
+ */
+
+struct ControlQuaternion
+{
+  double x, y, z, w;
+
+  ControlQuaternion() : x(0), y(0), z(0), w(1) {}
+  ControlQuaternion(double x, double y, double z, double w) : x(x), y(y), z(z), w(w) {}
+
+  static ControlQuaternion fromRPY(double roll, double pitch, double yaw);
+  static ControlQuaternion fromAxisAngle(double ax, double ay, double az, double angle);
+
+  ControlQuaternion operator*(const ControlQuaternion& q) const;
+  ControlQuaternion inverse() const { return ControlQuaternion(-x, -y, -z, w); }
+  ControlQuaternion slerp(const ControlQuaternion& q, double t) const;
+  void normalize();
+
+  // Same convention as tf::Matrix3x3::getEulerYPR
+  void getRPY(double& roll, double& pitch, double& yaw) const;
+  void rotate(const double v[3], double out[3]) const;
+};
+
+// The subset of AutopilotConfig used by the control law (same names), and the
+// SLERP options of LocalAutopilot. Defaults are LocalAutopilot's param defaults
+struct ControlGains
+{
+  double ROLL_P_GAIN, PITCH_P_GAIN, YAW_P_GAIN;
+  double ROLL_I_GAIN, PITCH_I_GAIN, YAW_I_GAIN;
+  double ROLL_D_GAIN, PITCH_D_GAIN, YAW_D_GAIN;
+  double ROLL_CONST_GAIN;
+  double MAX_INTEGRAL_ANGLE_ERROR;
+  double MAX_ROLL, MAX_PITCH, MAX_YAW, MAX_SPEED, MAX_HEAVE;
+  double KDEPTH, DEPTH_D_GAIN;
+  bool use_slerp;
+  double slerp_fraction; // fraction of the rotation to the target commanded with use_slerp
+
+  ControlGains();
+};
+
+struct ControlInput
+{
+  ControlQuaternion target_to_global;
+  ControlQuaternion imu_to_global;
+  double speed, heave;              // requested thrusts, in robot frame
+  bool regulate_depth;              // AP_GLOBAL_ANGLES_FIXED_DEPTH and AP_TRAJECTORY
+  double target_depth, depth;
+  double filtered_depth_derivative;
+  double roll_rate, pitch_rate, yaw_rate; // filtered angular velocity
+  double dt;                        // update period, for the integral terms
+
+  ControlInput();
+};
+
+// Integral terms, carried from one update to the next
+struct ControlState
+{
+  double integral_roll, integral_pitch, integral_yaw;
+
+  ControlState() { reset(); }
+  void reset() { integral_roll = integral_pitch = integral_yaw = 0.0; }
+};
+
+// Values reported in UberpilotStatus (same names and units)
+struct ControlDiagnostics
+{
+  double roll_target, pitch_target, yaw_target;          // deg
+  double current_roll, current_pitch, current_yaw;       // deg
+  double resultant_roll, resultant_pitch, resultant_yaw; // deg, after depth correction
+  double roll_error, pitch_error, yaw_error;             // rad, in IMU frame
+  double roll_error_integral, pitch_error_integral, yaw_error_integral;
+  double roll_p_contrib, pitch_p_contrib, yaw_p_contrib;
+  double roll_i_contrib, pitch_i_contrib, yaw_i_contrib;
+  double roll_d_contrib, pitch_d_contrib, yaw_d_contrib;
+  double roll_const_contrib;
+  double depth_error, depth_p_contrib, depth_d_contrib;
+  double depth_correction_angle;                         // rad
+};
+
+struct ControlOutput
+{
+  double roll, pitch, yaw, speed, heave;
+  ControlQuaternion target_to_global; // target after depth correction
+  ControlDiagnostics diag;
+  bool nan_detected;                  // a NaN was replaced by a zero command
+};
+
+void computeControl(const ControlGains& gains, const ControlInput& in, ControlState& state, ControlOutput& out);
+
+/** Function: applyExpFilter
+ *
+ * \param filter_time_constant: (in)     user configurable smoothing parameter (time units)
+ * \param sample_period       : (in)     time since the last call to this function (same time units)
+ * \param current_data        : (in)     the un-filtered target signal that we want to smooth
+ * \param previous_valid      : (in/out) indicator for first execution of this function. Set to false initially.
+ * \param filter_value        : (out)    smoothed version of current_data
+ */
+void applyExpFilter(double filter_time_constant, double sample_period, double current_data, bool &previous_valid, double &filter_value);
+
+#endif // AQUAAUTOPILOT_CONTROL_LAW_H
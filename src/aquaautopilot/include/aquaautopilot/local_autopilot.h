@@ -0,0 +1,1192 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef AQUAAUTOPILOT_LOCAL_AUTOPILOT_H
+#define AQUAAUTOPILOT_LOCAL_AUTOPILOT_H
+
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <aquacore/Command.h>
+#include <aquacore/SetGait.h>
+#include <aquacore/SetAutopilotMode.h>
+#include <std_msgs/Float32.h>
+#include <std_srvs/Empty.h>
+#include <aquacore/AutopilotModes.h>
+#include <aquacore/DepthEstimate.h>
+#include <aquaautopilot/AutopilotConfig.h>
+#include <aquaautopilot/UberpilotStatus.h>
+#include <aquaautopilot/orientation_slot.h>
+#include <aquaautopilot/autopilot_trace.h>
+#include <aquaautopilot/trajectory.h>
+#include <aquaautopilot/control_law.h>
+#include <aquaautopilot/FollowTrajectory.h>
+
+#include <geometry_msgs/PoseStamped.h>
+#include <sensor_msgs/Imu.h>
+#include <tf/transform_listener.h>
+#include <tf/transform_broadcaster.h>
+#include <angles/angles.h>
+#include <dynamic_reconfigure/server.h>
+#include <boost/shared_ptr.hpp>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+
+typedef dynamic_reconfigure::Server<aquaautopilot::AutopilotConfig> ReconfigureServer;
+using namespace aquaautopilot;
+
+#define PI 3.14159265359
+
+// Verbose diagnostics, printed when ~display_output is set. Building with
+// AQUAAUTOPILOT_NO_DISPLAY_OUTPUT defined removes them from the control update;
+// the binary trace (~trace_shm) remains available
+#ifdef AQUAAUTOPILOT_NO_DISPLAY_OUTPUT
+#define AP_DISPLAY(...) do { if (false) ROS_INFO(__VA_ARGS__); } while (0)
+#define AP_DISPLAY_STREAM(args) do { if (false) ROS_INFO_STREAM(args); } while (0)
+#else
+#define AP_DISPLAY(...) ROS_INFO_COND(display_output_, __VA_ARGS__)
+#define AP_DISPLAY_STREAM(args) ROS_INFO_STREAM_COND(display_output_, args)
+#endif
+
+class LocalAutopilot
+{
+
+private:
+
+  // ROS variables
+  ros::NodeHandle n_;
+  // Serves the sensor subscriptions with sensor-triggered updates (see control_trigger_).
+  // Declared before the subscribers, which unregister from it when they are destroyed
+  ros::CallbackQueue control_queue_;
+  ros::Timer keepalive_timer;
+  ros::Publisher cmd_pub_;
+  ros::Publisher ap_status_pub_;
+  ros::Subscriber target_sub_;
+  ros::Subscriber depth_sub_;
+  ros::Subscriber vel_sub_;
+  ros::Subscriber imu_sub_;
+  ros::ServiceServer mode_service_;
+  ros::ServiceServer reset_state_service_;
+  ros::ServiceServer trajectory_service_;
+  boost::shared_ptr<tf::TransformListener> listener_; // only with use_tf_orientation_
+  tf::TransformBroadcaster br_;
+  tf::Transform transform_;
+  ros::Publisher vis_pub1_;
+  ros::Publisher vis_pub2_;
+  ros::Publisher vis_pub3_;
+  ros::Publisher vis_pub4_;
+  ros::Publisher vis_pub5_;
+
+  // Variables related to the robot's current depth from sensors
+  double  current_depth;
+  ros::Time last_depth_reading_time_;
+  bool have_depth_;
+  bool use_depth_estimate_; // read /aqua/depth_estimate, with its rate if any, instead of /aqua/filtered_depth
+
+  // Variables related to the user's requested input
+  geometry_msgs::PoseStamped current_target_;
+  bool have_target_;
+  int curr_auto_mode_;
+
+  // Target trajectory for AP_TRAJECTORY, precomputed at the control rate
+  boost::shared_ptr<const AutopilotTrajectory> trajectory_;
+  ros::Time trajectory_start_;
+
+  // Latest IMU orientation (rotation from IMU to global frame), unless read from TF
+  OrientationSlot imu_orientation_;
+  bool use_tf_orientation_;
+  std::string imu_topic_;
+
+  // Variables related to reading the robot's velocity through the IMU
+  geometry_msgs::Twist current_velocity_;
+  bool have_velocity_;
+
+  // What runs the control update. With CONTROL_TRIGGER_VELOCITY or _IMU, the sensor
+  // subscriptions are served by control_queue_ on their own thread, and each message
+  // of the trigger topic runs an update; keepalive_timer only checks that they keep coming
+  enum ControlTrigger { CONTROL_TRIGGER_TIMER, CONTROL_TRIGGER_VELOCITY, CONTROL_TRIGGER_IMU };
+  ControlTrigger control_trigger_;
+  ros::Duration sensor_timeout_;
+  ros::Time last_trigger_time_;
+  bool have_trigger_;
+
+  // Held by all callbacks that read or write the control state, since the
+  // sensor-triggered updates run concurrently with the other callbacks
+  std::mutex state_mutex_;
+
+  // Gains and parameters for the angle and speed PID controllers. Snapshots are
+  // immutable: configCallback() publishes a new one, and each update loads the
+  // current one once, so the control loop never waits for dynamic reconfigure
+  typedef std::shared_ptr<const AutopilotConfig> ParamsConstPtr;
+  ParamsConstPtr params_;
+  ReconfigureServer* dyncfg_server_;
+  bool dyncfg_sync_request_;
+  bool use_slerp;
+  double slerp_fraction_;
+  bool use_robot_frame_depth;
+
+  // Watchdog timer parameters
+  ros::Duration depth_lifetime_;
+  ros::Duration target_lifetime_;
+
+  // Members used in control computations
+  double depth_derivative_;
+  double last_depth_;
+  double filtered_depth_derivative_;
+  bool have_filtered_depth_derivative_;
+
+  geometry_msgs::Twist filtered_velocity_;
+  ros::Time last_velocity_reading_time_;
+  bool have_roll_filtered_deriv_;
+  bool have_pitch_filtered_deriv_;
+  bool have_yaw_filtered_deriv_;
+
+  double update_period_;
+  aquacore::Command latest_cmd_;
+
+  // Published command messages. Publishing by pointer lets subscribers in the same process
+  // (nodelets) share a message, so a pooled one is only reused once nobody else holds it
+  static const int CMD_MSG_POOL_SIZE = 4;
+  aquacore::CommandPtr cmd_msg_pool_[CMD_MSG_POOL_SIZE];
+  int cmd_msg_next_;
+  ControlState control_state_; // integral terms of the control law
+  tf::Quaternion rotation_from_imu_to_global_, rotation_from_target_to_global_, rotation_command_in_robot_frame_;
+
+  bool display_output_;
+
+  // Binary trace of each update, read with autopilot_trace_dump
+  AutopilotTrace trace_;
+
+  // The logging variable
+  aquaautopilot::UberpilotStatus stat;
+
+  // This was used in an attempt to differentiate angles. Unused currently
+  //tf::Quaternion rotation_from_previous_imu_to_global_;
+
+  // Serves control_queue_. Last member, so that it stops before the rest is destroyed
+  boost::shared_ptr<ros::AsyncSpinner> control_spinner_;
+
+public:
+
+// n is the private node handle; topic and service names are absolute
+explicit LocalAutopilot(const ros::NodeHandle& n = ros::NodeHandle("~")) :
+  n_(n),
+  params_(new AutopilotConfig()),
+  dyncfg_sync_request_(false),
+  cmd_msg_next_(0)
+{
+  double lifetime_param;
+
+  initialize_local_variables();
+
+  cmd_pub_ = n_.advertise<aquacore::Command>("/aqua/command", 1);
+  ap_status_pub_ = n_.advertise<aquaautopilot::UberpilotStatus>("/aqua/autopilot/status", 1);
+
+  // Setup dynamic reconfigure server
+  // NOTE: this should be set up prior to loading (static) ROS params, so that launch file param values gets prioritized over older dyncfg values
+  dyncfg_server_ = new ReconfigureServer(n_);
+  dyncfg_server_->setCallback(bind(&LocalAutopilot::configCallback, this, _1, _2));
+
+  AutopilotConfig params = *loadParams();
+  n_.param<double>("lifetime",lifetime_param, 3.0);
+
+  n_.param<double>("ROLL_P_GAIN", params.ROLL_P_GAIN, 1.0 );
+  n_.param<double>("PITCH_P_GAIN", params.PITCH_P_GAIN, 2.0 );
+  n_.param<double>("YAW_P_GAIN", params.YAW_P_GAIN, -3.5 );
+
+  n_.param<double>("ROLL_I_GAIN", params.ROLL_I_GAIN, 0.0 );
+  n_.param<double>("PITCH_I_GAIN", params.PITCH_I_GAIN, 0.0 );
+  n_.param<double>("YAW_I_GAIN", params.YAW_I_GAIN, 0.0 );
+
+  n_.param<double>("ROLL_D_GAIN", params.ROLL_D_GAIN, 0.0 );
+  n_.param<double>("PITCH_D_GAIN", params.PITCH_D_GAIN, 0.0 );
+  n_.param<double>("YAW_D_GAIN", params.YAW_D_GAIN, 0.0 );
+
+  n_.param<double>("ROLL_CONST_GAIN", params.ROLL_CONST_GAIN, 0.0 );
+
+  n_.param<double>("ROLL_D_FILTER_PERIOD", params.ROLL_D_FILTER_PERIOD, 0.0);
+  n_.param<double>("PITCH_D_FILTER_PERIOD", params.PITCH_D_FILTER_PERIOD, 0.0);
+  n_.param<double>("YAW_D_FILTER_PERIOD", params.YAW_D_FILTER_PERIOD, 0.0);
+
+  n_.param<double>("MAX_INTEGRAL_ANGLE_ERROR", params.MAX_INTEGRAL_ANGLE_ERROR, 10.0 );
+
+  n_.param<double>("KSPEED", params.KSPEED, 1.0);
+  n_.param<double>("KHEAVE",params.KHEAVE,1.0);
+  n_.param<double>("MAX_ROLL", params.MAX_ROLL,1.0);
+  n_.param<double>("MAX_PITCH", params.MAX_PITCH,1.0);
+  n_.param<double>("MAX_YAW", params.MAX_YAW,1.0);
+  n_.param<double>("MAX_SPEED", params.MAX_SPEED,1.0);
+  n_.param<double>("MAX_HEAVE", params.MAX_HEAVE,1.0);
+
+  n_.param<double>("KDEPTH", params.KDEPTH, 0.3);
+  n_.param<double>("DEPTH_D_GAIN", params.DEPTH_D_GAIN, 0.0);
+  n_.param<double>("DEPTH_D_FILTER_PERIOD", params.DEPTH_D_FILTER_PERIOD, 0.6);
+
+  n_.param<bool>("use_slerp", use_slerp, true);
+  n_.param<double>("slerp_fraction", slerp_fraction_, 0.3);
+  n_.param<bool>("use_robot_frame_depth", use_robot_frame_depth, true);
+  n_.param<bool>("use_depth_estimate", use_depth_estimate_, false);
+
+  n_.param<bool>("display_output", display_output_,false);
+
+  // The orientation is read from the IMU topic directly; the /latest_fix -> /aqua_base
+  // TF lookup is kept as an option, since it requires buffering the whole /tf stream
+  n_.param<bool>("use_tf_orientation", use_tf_orientation_, false);
+  n_.param<std::string>("imu_topic", imu_topic_, "/aqua/imu");
+
+  std::string trajectory_file;
+  bool trajectory_loop;
+  n_.param<std::string>("trajectory_file", trajectory_file, "");
+  n_.param<bool>("trajectory_loop", trajectory_loop, false);
+  if (!trajectory_file.empty())
+  {
+    std::string error;
+    trajectory_ = loadTrajectory(trajectory_file, trajectory_loop, error);
+    if (!trajectory_)
+    {
+      ROS_WARN_STREAM("Failed to load trajectory: " << error);
+    }
+  }
+
+  std::string control_trigger;
+  double sensor_timeout;
+  n_.param<std::string>("control_trigger", control_trigger, "timer");
+  n_.param<double>("sensor_timeout", sensor_timeout, 0.1);
+  sensor_timeout_ = ros::Duration(sensor_timeout);
+  if (control_trigger == "velocity")
+  {
+    control_trigger_ = CONTROL_TRIGGER_VELOCITY;
+  }
+  else if (control_trigger == "imu" && !use_tf_orientation_)
+  {
+    control_trigger_ = CONTROL_TRIGGER_IMU;
+  }
+  else
+  {
+    if (control_trigger != "timer")
+    {
+      ROS_WARN_STREAM("Unsupported control_trigger " << control_trigger << " (imu requires use_tf_orientation false). Using the timer.");
+    }
+    control_trigger_ = CONTROL_TRIGGER_TIMER;
+  }
+
+  std::string trace_shm;
+  int trace_capacity;
+  n_.param<std::string>("trace_shm", trace_shm, "");
+  n_.param<int>("trace_capacity", trace_capacity, 6000);
+  if (!trace_shm.empty())
+  {
+    if (trace_capacity > 0 && trace_.open(trace_shm, trace_capacity))
+    {
+      ROS_INFO_STREAM("Tracing autopilot updates to shared memory " << trace_shm);
+    }
+    else
+    {
+      ROS_WARN_STREAM("Failed to create autopilot trace " << trace_shm);
+    }
+  }
+
+  if( display_output_)
+  {
+    ROS_INFO( "3D Autopilot will print output because display_output parameter was true.");
+  }
+  else
+  {
+    ROS_INFO( "3D Autopilot running silently because display_output parameter was false.");
+  }
+
+
+  dyncfg_sync_request_ = true;
+
+  AP_DISPLAY( "Local AP starting with:\nROLL_P_GAIN: %f,\nPITCH_P_GAIN: %f,\nYAW_P_GAIN: %f,\nKSPEED: %f,\nKHEAVE: %f,\nMAX_ROLL: %f,\nMAX_PITCH: %f,\nMAX_YAW: %f.\n",
+      params.ROLL_P_GAIN, params.PITCH_P_GAIN, params.YAW_P_GAIN, params.KSPEED, params.KHEAVE, params.MAX_ROLL, params.MAX_PITCH, params.MAX_YAW);
+
+  if( use_slerp )
+  {
+    AP_DISPLAY( "I am using SLERP to interpolate angles.");
+  }
+  else
+  {
+    AP_DISPLAY( "Not using SLERP interpolation.");
+  }
+
+  storeParams(params);
+
+  target_lifetime_ = ros::Duration(lifetime_param);
+  depth_lifetime_ = ros::Duration(lifetime_param);
+
+  // Set the gait of the robot to hover-midoff
+  aquacore::SetGait typSetGait;
+  ros::ServiceClient clnSetGait;
+  ROS_INFO_STREAM("Waiting for service /aqua/set_gait...");
+  ros::service::waitForService("/aqua/set_gait");
+  ROS_INFO_STREAM("... found!");
+  clnSetGait = n_.serviceClient<aquacore::SetGait>("/aqua/set_gait");
+  typSetGait.request.gait = "flexible-sine"; // TODO: have some way to toggle back to hover-midoff, if we ever want to throw away N months of gait learning code
+  if (!clnSetGait.call(typSetGait))
+  {
+    ROS_WARN_STREAM(ros::this_node::getName() << ": failed to set gait to " << typSetGait.request.gait );
+    //ros::shutdown();
+  }
+  else
+  {
+    AP_DISPLAY( "Gait successfully set to %s.\n", typSetGait.request.gait.c_str());
+  }
+
+  // Disable the Robo-devel autopilot
+  aquacore::SetAutopilotMode typSetAPMode;
+  ros::ServiceClient clnSetAPMode;  
+  ROS_INFO_STREAM("Waiting for service /aqua/set_autopilot_mode...");
+  ros::service::waitForService("/aqua/set_autopilot_mode");
+  ROS_INFO_STREAM("... found!");
+  clnSetAPMode = n_.serviceClient<aquacore::SetAutopilotMode>("/aqua/set_autopilot_mode");
+  typSetAPMode.request.mode = aquacore::AutopilotModes::OFF;
+  if (!clnSetAPMode.call(typSetAPMode) || !typSetAPMode.response.response )
+  {
+    ROS_WARN_STREAM(ros::this_node::getName() << ": failed to set Robodevel AP mode to " << 
+        typSetAPMode.request.mode << ". Response was: " << typSetAPMode.response.response );
+    //ros::shutdown();
+  }
+  else
+  {
+    AP_DISPLAY( "Successfully disabled the Robodevel autopilot.\n");
+  }
+
+  vis_pub1_ = n_.advertise<geometry_msgs::PoseStamped>("/aqua/traj3Dvis1", 1);
+  vis_pub2_ = n_.advertise<geometry_msgs::PoseStamped>("/aqua/traj3Dvis2", 1);
+  vis_pub3_ = n_.advertise<geometry_msgs::PoseStamped>("/aqua/traj3Dvis3", 1);
+  vis_pub4_ = n_.advertise<geometry_msgs::PoseStamped>("/aqua/traj3Dvis4", 1);
+  vis_pub5_ = n_.advertise<geometry_msgs::PoseStamped>("/aqua/traj3Dvis5", 1);
+
+  mode_service_ = n_.advertiseService("/aqua/set_3Dauto_mode", &LocalAutopilot::set_autopilot_mode,this);
+  reset_state_service_ = n_.advertiseService("/aqua/reset_3D_autopilot_state", &LocalAutopilot::reset_state,this);
+  trajectory_service_ = n_.advertiseService("/aqua/follow_3D_trajectory", &LocalAutopilot::follow_trajectory,this);
+
+  if (use_depth_estimate_)
+  {
+    depth_sub_ = n_.subscribe<aquacore::DepthEstimate>("/aqua/depth_estimate", 1, &LocalAutopilot::depthEstimateCallback, this);
+  }
+  else
+  {
+    depth_sub_ = n_.subscribe<std_msgs::Float32>("/aqua/filtered_depth", 1, &LocalAutopilot::depthCallback, this);
+  }
+  target_sub_ = n_.subscribe<geometry_msgs::PoseStamped>("/aqua/target_pose", 1, &LocalAutopilot::targetCallback, this);
+
+  // The sensors that trigger updates are read on control_queue_, without Nagle delays
+  ros::NodeHandle sensor_nh(n_);
+  ros::TransportHints sensor_hints;
+  if (control_trigger_ != CONTROL_TRIGGER_TIMER)
+  {
+    sensor_nh.setCallbackQueue(&control_queue_);
+    sensor_hints = sensor_hints.tcpNoDelay();
+  }
+  vel_sub_ = sensor_nh.subscribe<geometry_msgs::Twist>("/aqua/positioning/angular_velocity", 1, &LocalAutopilot::velocityCallback, this, sensor_hints);
+  if (use_tf_orientation_)
+  {
+    listener_.reset(new tf::TransformListener(n_));
+  }
+  else
+  {
+    imu_sub_ = sensor_nh.subscribe<sensor_msgs::Imu>(imu_topic_, 1, &LocalAutopilot::imuCallback, this, sensor_hints);
+  }
+  keepalive_timer = n_.createTimer(ros::Duration(update_period_), &LocalAutopilot::keepalive, this);
+
+  if (control_trigger_ != CONTROL_TRIGGER_TIMER)
+  {
+    ROS_INFO_STREAM("Running the control update on each " << control_trigger << " message, with a "
+                    << sensor_timeout << " s watchdog.");
+    control_spinner_.reset(new ros::AsyncSpinner(1, &control_queue_));
+    control_spinner_->start();
+  }
+}
+
+~LocalAutopilot()
+{
+  if (control_spinner_)
+  {
+    control_spinner_->stop();
+  }
+  vel_sub_.shutdown();
+  imu_sub_.shutdown();
+}
+
+void initialize_local_variables()
+{
+  have_depth_ = false;
+  have_target_ = false;
+  have_velocity_ = false;
+  have_trigger_ = false;
+  curr_auto_mode_ = aquacore::AutopilotModes::AP_OFF;
+
+  update_period_  = 0.02;
+
+  have_filtered_depth_derivative_ = false;
+  filtered_depth_derivative_ = 0.0;
+  depth_derivative_ = 0.0;
+  last_depth_ = 0.0;
+
+  control_state_.reset();
+
+  filtered_velocity_.angular.x = 0.0;
+  filtered_velocity_.angular.y = 0.0;
+  filtered_velocity_.angular.z = 0.0;
+}
+
+void spin() {
+  ros::Rate hz(30);
+  while (ros::ok())
+  {
+    ros::spinOnce();
+    syncDyncfg();
+    hz.sleep();
+  }
+}
+
+// Update params back to dyncfg server
+void syncDyncfg() {
+  if (dyncfg_sync_request_)
+  {
+    dyncfg_server_->updateConfig(*loadParams());
+    dyncfg_sync_request_ = false;
+  }
+}
+
+protected:
+
+void configCallback(aquaautopilot::AutopilotConfig& config, uint32_t level) {
+  storeParams(config);
+};
+
+// The current parameter snapshot; it stays valid for as long as it is held
+ParamsConstPtr loadParams() const
+{
+  return std::atomic_load(&params_);
+}
+
+void storeParams( const AutopilotConfig& params )
+{
+  std::atomic_store(&params_, ParamsConstPtr(new AutopilotConfig(params)));
+}
+
+void keepalive(const ros::TimerEvent& e){
+  std::lock_guard<std::mutex> lock(state_mutex_);
+  if (control_trigger_ != CONTROL_TRIGGER_TIMER)
+  {
+    checkSensorWatchdog();
+    return;
+  }
+
+  AP_DISPLAY( "\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\nAquaAutopilot update started.");
+  doAutopilotUpdate(update_period_);
+}
+
+// Runs an update for a message of the trigger topic, on the control thread.
+// Called with state_mutex_ held
+void sensorTriggeredUpdate()
+{
+  ros::Time now = ros::Time::now();
+  double dt = update_period_;
+  if (have_trigger_)
+  {
+    // the integral terms use the actual period, bounded after a gap
+    dt = std::min(std::max((now - last_trigger_time_).toSec(), 0.0), sensor_timeout_.toSec());
+  }
+  last_trigger_time_ = now;
+  have_trigger_ = true;
+
+  AP_DISPLAY( "AquaAutopilot sensor-triggered update started.");
+  doAutopilotUpdate(dt);
+}
+
+// Commands zero when the trigger topic stopped, since no update would replace the
+// last command otherwise. Called with state_mutex_ held
+void checkSensorWatchdog()
+{
+  if (curr_auto_mode_ == aquacore::AutopilotModes::AP_OFF ||
+      (have_trigger_ && ros::Time::now() - last_trigger_time_ <= sensor_timeout_))
+  {
+    return;
+  }
+
+  ROS_WARN_THROTTLE(1.0, "No sensor-triggered autopilot update for %f s. Sending zero command.", sensor_timeout_.toSec());
+  aquacore::Command zero_command;
+  zero_command.roll = 0.0;
+  zero_command.pitch = 0.0;
+  zero_command.yaw = 0.0;
+  zero_command.speed = 0.0;
+  zero_command.heave = 0.0;
+  publishCommand(zero_command, AP_TRACE_SENSOR_TIMEOUT);
+}
+
+bool reset_state( std_srvs::Empty::Request& req, std_srvs::Empty::Response& resp )
+{
+  std::lock_guard<std::mutex> lock(state_mutex_);
+  initialize_local_variables();
+
+  return true;
+}
+
+bool set_autopilot_mode(aquacore::SetAutopilotMode::Request  &req, aquacore::SetAutopilotMode::Response &res){
+  ros::Time now = ros::Time::now();
+  std::lock_guard<std::mutex> lock(state_mutex_);
+
+  if( req.mode < 0 || req.mode >= aquacore::AutopilotModes::AP_FIRST_INVALID_AP_MODE )
+  {
+    res.response = false;
+  }
+  else if( req.mode == aquacore::AutopilotModes::AP_TRAJECTORY && !trajectory_ )
+  {
+    ROS_WARN("Cannot follow a trajectory: none was loaded (see ~trajectory_file and /aqua/follow_3D_trajectory).");
+    res.response = false;
+  }
+  else
+  {
+    if( req.mode == aquacore::AutopilotModes::AP_TRAJECTORY )
+    {
+      trajectory_start_ = now;
+    }
+    curr_auto_mode_ = req.mode;
+    res.response = true;
+  }
+
+  return true;
+}
+
+bool follow_trajectory(aquaautopilot::FollowTrajectory::Request &req, aquaautopilot::FollowTrajectory::Response &res)
+{
+  // Reading and precomputing the file is slow, so it is done before taking the
+  // lock; the control updates only wait for the pointer swap
+  boost::shared_ptr<const AutopilotTrajectory> trajectory;
+  if( !req.path.empty() )
+  {
+    trajectory = loadTrajectory(req.path, req.loop, res.message);
+    if( !trajectory )
+    {
+      res.success = false;
+      return true;
+    }
+  }
+
+  ros::Time now = ros::Time::now();
+  std::lock_guard<std::mutex> lock(state_mutex_);
+  if( trajectory )
+  {
+    // the replaced table is freed by the local, after the lock is released
+    trajectory_.swap(trajectory);
+  }
+  res.success = (bool) trajectory_;
+  if( !res.success )
+  {
+    res.message = "no trajectory loaded";
+  }
+  else
+  {
+    trajectory_start_ = now;
+    curr_auto_mode_ = aquacore::AutopilotModes::AP_TRAJECTORY;
+    res.duration = trajectory_->getDuration();
+  }
+
+  return true;
+}
+
+// Loads and precomputes a trajectory file; the update only indexes into the result.
+// Returns null on failure. Does not touch the control state, so needs no lock
+boost::shared_ptr<const AutopilotTrajectory> loadTrajectory( const std::string& path, bool loop, std::string& error )
+{
+  boost::shared_ptr<AutopilotTrajectory> trajectory(new AutopilotTrajectory());
+  if( !trajectory->load(path, update_period_, loop, error) )
+  {
+    return boost::shared_ptr<const AutopilotTrajectory>();
+  }
+
+  ROS_INFO_STREAM("Loaded " << trajectory->getDuration() << " s trajectory from " << path);
+  return trajectory;
+}
+
+// Replaces the user target with the trajectory sample for this update
+void updateTrajectoryTarget()
+{
+  ros::Time now = ros::Time::now();
+  AutopilotTrajectory::Sample sample = trajectory_->sample((now - trajectory_start_).toSec());
+
+  tf::quaternionTFToMsg(sample.orientation, current_target_.pose.orientation);
+  current_target_.pose.position.x = sample.speed;
+  current_target_.pose.position.y = sample.heave;
+  current_target_.pose.position.z = sample.depth;
+  current_target_.header.stamp = now;
+  have_target_ = true;
+}
+
+void depthCallback(const std_msgs::Float32::ConstPtr& filtered_depth )
+{
+  std::lock_guard<std::mutex> lock(state_mutex_);
+  updateDepth(filtered_depth->data, false, 0.0);
+}
+
+// With a depth rate (kalman estimator of the depth filter), the rate is used as the
+// filtered depth derivative directly, instead of differentiating and filtering the depth
+void depthEstimateCallback(const aquacore::DepthEstimate::ConstPtr& estimate )
+{
+  std::lock_guard<std::mutex> lock(state_mutex_);
+  updateDepth(estimate->depth, estimate->has_rate, estimate->depth_rate);
+}
+
+// Called with state_mutex_ held
+void updateDepth( double depth, bool has_rate, double depth_rate )
+{
+  current_depth = depth;
+  
+  if (use_robot_frame_depth) {
+    tf::Quaternion Q_from_imu_to_global;
+    double curr_r_in_global, curr_p_in_global, curr_y_in_global;
+    try
+    {
+      lookupImuOrientation(Q_from_imu_to_global);
+      getRPY(Q_from_imu_to_global, curr_r_in_global, curr_p_in_global, curr_y_in_global);
+
+      double length_of_robot = 0.6; // in meters
+      current_depth = current_depth + sin(curr_p_in_global)*length_of_robot/2.0;
+    }
+    catch (tf::TransformException ex)
+    {
+      ROS_WARN_THROTTLE(1.0, "No orientation for robot frame depth (%s). Using sensor depth.", ex.what());
+    }
+  }
+  
+  if( has_rate )
+  {
+    depth_derivative_ = depth_rate;
+    filtered_depth_derivative_ = depth_rate;
+  }
+  else if( !have_depth_ )
+  {
+    depth_derivative_ = 0.0;
+    filtered_depth_derivative_ = 0.0;
+  }
+  else
+  {
+    const ParamsConstPtr params = loadParams();
+    ros::Duration depth_time_difference = ros::Time::now() - last_depth_reading_time_;
+    if( depth_time_difference.toSec() < fabs(1e-9))
+    {
+      ROS_WARN( "Skipping depth derivative update because of near-zero timestep.");
+      return;
+    }
+
+    depth_derivative_ = ( current_depth - last_depth_ ) / depth_time_difference.toSec();
+
+
+    applyExpFilter( params->DEPTH_D_FILTER_PERIOD, depth_time_difference.toSec(), depth_derivative_, have_filtered_depth_derivative_, filtered_depth_derivative_ );
+
+    //AP_DISPLAY( "Depth time difference: %f (s). Depth_derivative_: %f, filtered depth: %f.", depth_time_difference.toSec(), depth_derivative_, filtered_depth_derivative_);
+    //if( filtered_depth_derivative_ != filtered_depth_derivative_ )
+    //{
+    //  AP_DISPLAY( "NaN filtered derivative detected.");
+    //  ros::shutdown();
+    //}
+  }
+
+  have_depth_ = true;
+  last_depth_reading_time_ = ros::Time::now();
+  last_depth_ = current_depth;
+
+}
+
+void targetCallback(const geometry_msgs::PoseStamped::ConstPtr& targetPose )
+{
+  std::lock_guard<std::mutex> lock(state_mutex_);
+  current_target_ = *targetPose;
+  have_target_ = true;
+}
+
+void imuCallback(const sensor_msgs::Imu::ConstPtr& imu_msg )
+{
+  tf::Quaternion q;
+  tf::quaternionMsgToTF(imu_msg->orientation, q);
+  imu_orientation_.write(q);
+
+  if (control_trigger_ == CONTROL_TRIGGER_IMU)
+  {
+    std::lock_guard<std::mutex> lock(state_mutex_);
+    sensorTriggeredUpdate();
+  }
+}
+
+/** Function: lookupImuOrientation
+ *
+ * \param rotation_from_imu_to_global: (out) latest orientation of the robot
+ *
+ * Throws tf::TransformException if no orientation is available yet.
+ */
+void lookupImuOrientation( tf::Quaternion &rotation_from_imu_to_global )
+{
+  if (use_tf_orientation_)
+  {
+    tf::StampedTransform transform_from_global_to_imu;
+    listener_->lookupTransform("/aqua_base", "/latest_fix", ros::Time(0), transform_from_global_to_imu);
+    rotation_from_imu_to_global = transform_from_global_to_imu.inverse().getRotation();
+  }
+  else if (!imu_orientation_.read(rotation_from_imu_to_global))
+  {
+    throw tf::TransformException("no orientation received on " + imu_topic_ + " yet");
+  }
+}
+
+void velocityCallback(const geometry_msgs::Twist::ConstPtr& vel_msg )
+{
+  std::lock_guard<std::mutex> lock(state_mutex_);
+  current_velocity_ = *vel_msg;
+
+  if( !have_velocity_ )
+  {
+    filtered_velocity_ = current_velocity_;
+  }
+  else
+  {
+    const ParamsConstPtr params = loadParams();
+    ros::Duration velocity_time_difference = ros::Time::now() -  last_velocity_reading_time_; 
+    applyExpFilter( params->ROLL_D_FILTER_PERIOD, velocity_time_difference.toSec(), current_velocity_.angular.x , have_roll_filtered_deriv_, filtered_velocity_.angular.x );
+    applyExpFilter( params->PITCH_D_FILTER_PERIOD, velocity_time_difference.toSec(), current_velocity_.angular.y , have_pitch_filtered_deriv_, filtered_velocity_.angular.y );
+    applyExpFilter( params->YAW_D_FILTER_PERIOD, velocity_time_difference.toSec(), current_velocity_.angular.z , have_yaw_filtered_deriv_, filtered_velocity_.angular.z );
+    //filtered_velocity = 
+  }
+
+  last_velocity_reading_time_ = ros::Time::now();
+  have_velocity_ = true;
+
+  if (control_trigger_ == CONTROL_TRIGGER_VELOCITY)
+  {
+    sensorTriggeredUpdate();
+  }
+}
+
+static ControlQuaternion toControlQuaternion(const tf::Quaternion& q)
+{
+  return ControlQuaternion(q.x(), q.y(), q.z(), q.w());
+}
+
+void getRPY(const tf::Quaternion& tf_q, double &r, double &p, double &y )
+{
+  tf::Matrix3x3(tf_q).getEulerYPR( y,p,r );
+}
+
+// Runs the control law (control_law.h) on the current target, orientation and
+// rates, and fills in the command and the status message
+void runControlLaw( bool regulate_depth, double dt, const AutopilotConfig &params, aquacore::Command &updated_command )
+{
+  ControlGains gains;
+  gains.ROLL_P_GAIN = params.ROLL_P_GAIN;
+  gains.PITCH_P_GAIN = params.PITCH_P_GAIN;
+  gains.YAW_P_GAIN = params.YAW_P_GAIN;
+  gains.ROLL_I_GAIN = params.ROLL_I_GAIN;
+  gains.PITCH_I_GAIN = params.PITCH_I_GAIN;
+  gains.YAW_I_GAIN = params.YAW_I_GAIN;
+  gains.ROLL_D_GAIN = params.ROLL_D_GAIN;
+  gains.PITCH_D_GAIN = params.PITCH_D_GAIN;
+  gains.YAW_D_GAIN = params.YAW_D_GAIN;
+  gains.ROLL_CONST_GAIN = params.ROLL_CONST_GAIN;
+  gains.MAX_INTEGRAL_ANGLE_ERROR = params.MAX_INTEGRAL_ANGLE_ERROR;
+  gains.MAX_ROLL = params.MAX_ROLL;
+  gains.MAX_PITCH = params.MAX_PITCH;
+  gains.MAX_YAW = params.MAX_YAW;
+  gains.MAX_SPEED = params.MAX_SPEED;
+  gains.MAX_HEAVE = params.MAX_HEAVE;
+  gains.KDEPTH = params.KDEPTH;
+  gains.DEPTH_D_GAIN = params.DEPTH_D_GAIN;
+  gains.use_slerp = use_slerp;
+  gains.slerp_fraction = slerp_fraction_;
+
+  ControlInput in;
+  in.target_to_global = toControlQuaternion(rotation_from_target_to_global_);
+  in.imu_to_global = toControlQuaternion(rotation_from_imu_to_global_);
+  in.speed = current_target_.pose.position.x;
+  in.heave = current_target_.pose.position.y;
+  in.regulate_depth = regulate_depth;
+  in.target_depth = current_target_.pose.position.z;
+  in.depth = current_depth;
+  in.filtered_depth_derivative = filtered_depth_derivative_;
+  in.roll_rate = filtered_velocity_.angular.x;
+  in.pitch_rate = filtered_velocity_.angular.y;
+  in.yaw_rate = filtered_velocity_.angular.z;
+  in.dt = dt;
+
+  ControlOutput out;
+  computeControl(gains, in, control_state_, out);
+  if (out.nan_detected)
+  {
+    ROS_ERROR( "NaN value in the control law. Autopilot most likely will not work after this!");
+  }
+
+  const ControlDiagnostics& diag = out.diag;
+  rotation_from_target_to_global_.setValue(out.target_to_global.x, out.target_to_global.y,
+                                           out.target_to_global.z, out.target_to_global.w);
+
+  if (regulate_depth)
+  {
+    AP_DISPLAY( "Correcting for a depth error of: %f with angle of %f.", diag.depth_error, 180.0/PI*diag.depth_correction_angle);
+  }
+  AP_DISPLAY( "Resultant target angles in global frame:\n   roll: %f   pitch: %f   yaw: %f",
+     diag.resultant_roll, diag.resultant_pitch, diag.resultant_yaw);
+  AP_DISPLAY( "The desired angle changes in IMU frame are:\n   roll: %f   pitch: %f   yaw: %f",
+     180.0/PI*diag.roll_error, 180.0/PI*diag.pitch_error, 180.0/PI*diag.yaw_error);
+
+  AP_DISPLAY( "Using gains of:\n   KDEPTH=%f   KSPEED=%f   KHEAVE=%f",
+            params.KDEPTH, params.KSPEED, params.KHEAVE);
+
+  AP_DISPLAY( "   ROLL_P=%f   PITCH_P=%f   YAW_P=%f ",
+            params.ROLL_P_GAIN, params.PITCH_P_GAIN, params.YAW_P_GAIN );
+
+  AP_DISPLAY( "   ROLL_I=%f   PITCH_I=%f   YAW_I=%f",
+            params.ROLL_I_GAIN, params.PITCH_I_GAIN, params.YAW_I_GAIN );
+
+  AP_DISPLAY( "   ROLL_D=%f   PITCH_D=%f   YAW_D=%f",
+            params.ROLL_D_GAIN, params.PITCH_D_GAIN, params.YAW_D_GAIN );
+
+  // Now: I LIKE TO SLERP IT SLERP IT!: http://www.youtube.com/watch?v=Dyx4v1QFzhQ
+  // (visualization only, so the samples are computed for subscribed topics only)
+  ros::Publisher* vis_pubs[5] = { &vis_pub1_, &vis_pub2_, &vis_pub3_, &vis_pub4_, &vis_pub5_ };
+  for( int i = 0; i < 5; i++ )
+  {
+    if( vis_pubs[i]->getNumSubscribers() == 0 )
+    {
+      continue;
+    }
+
+    double interp = 0.1 + 0.2 * i;
+    geometry_msgs::PoseStamped cmd;
+    cmd.header.stamp = ros::Time::now();
+    cmd.header.frame_id = "/latest_fix";
+
+    cmd.pose.position.x = 0; //curr_speed_;
+    cmd.pose.position.y = 0; //curr_heave_;
+    cmd.pose.position.z = 0; //curr_depth_;
+
+    tf::Quaternion slerp_rotation_from_target_to_global = rotation_from_imu_to_global_.slerp(rotation_from_target_to_global_, interp );
+    tf::quaternionTFToMsg(slerp_rotation_from_target_to_global, cmd.pose.orientation);
+
+    vis_pubs[i]->publish( cmd );
+  }
+
+  stat.roll_target = diag.roll_target;
+  stat.pitch_target = diag.pitch_target;
+  stat.yaw_target = diag.yaw_target;
+  stat.current_roll = diag.current_roll;
+  stat.current_pitch = diag.current_pitch;
+  stat.current_yaw = diag.current_yaw;
+  stat.resultant_roll = diag.resultant_roll;
+  stat.resultant_pitch = diag.resultant_pitch;
+  stat.resultant_yaw = diag.resultant_yaw;
+
+  stat.roll_error = diag.roll_error;
+  stat.pitch_error = diag.pitch_error;
+  stat.yaw_error = diag.yaw_error;
+
+  stat.roll_p_gain  = params.ROLL_P_GAIN;
+  stat.pitch_p_gain = params.PITCH_P_GAIN;
+  stat.yaw_p_gain   = params.YAW_P_GAIN;
+  stat.roll_i_gain  = params.ROLL_I_GAIN;
+  stat.pitch_i_gain = params.PITCH_I_GAIN;
+  stat.yaw_i_gain   = params.YAW_I_GAIN;
+  stat.roll_d_gain  = params.ROLL_D_GAIN;
+  stat.pitch_d_gain = params.PITCH_D_GAIN;
+  stat.yaw_d_gain   = params.YAW_D_GAIN;
+  stat.roll_const_gain = params.ROLL_CONST_GAIN;
+
+  stat.roll_error_integral = diag.roll_error_integral;
+  stat.pitch_error_integral = diag.pitch_error_integral;
+  stat.yaw_error_integral = diag.yaw_error_integral;
+
+  stat.roll_p_contrib = diag.roll_p_contrib;
+  stat.pitch_p_contrib = diag.pitch_p_contrib;
+  stat.yaw_p_contrib = diag.yaw_p_contrib;
+  stat.roll_i_contrib = diag.roll_i_contrib;
+  stat.pitch_i_contrib = diag.pitch_i_contrib;
+  stat.yaw_i_contrib = diag.yaw_i_contrib;
+  stat.roll_d_contrib = diag.roll_d_contrib;
+  stat.pitch_d_contrib = diag.pitch_d_contrib;
+  stat.yaw_d_contrib = diag.yaw_d_contrib;
+  stat.roll_const_contrib = diag.roll_const_contrib;
+
+  stat.filtered_roll_deriv = filtered_velocity_.angular.x;
+  stat.filtered_pitch_deriv = filtered_velocity_.angular.y;
+  stat.filtered_yaw_deriv = filtered_velocity_.angular.z;
+
+  stat.roll_d_filter_period = params.ROLL_D_FILTER_PERIOD;
+  stat.pitch_d_filter_period = params.PITCH_D_FILTER_PERIOD;
+  stat.yaw_d_filter_period = params.YAW_D_FILTER_PERIOD;
+
+  if (regulate_depth)
+  {
+    stat.depth_p_gain = params.KDEPTH;
+    stat.depth_p_contrib = diag.depth_p_contrib;
+    stat.depth_d_gain = params.DEPTH_D_GAIN;
+    stat.depth_d_contrib = diag.depth_d_contrib;
+    stat.depth_derivative = depth_derivative_;
+    stat.filtered_depth_derivative = filtered_depth_derivative_;
+    stat.depth_d_filter_period = params.DEPTH_D_FILTER_PERIOD;
+    stat.depth_error = diag.depth_error;
+  }
+
+  updated_command.roll = out.roll;
+  updated_command.pitch = out.pitch;
+  updated_command.yaw = out.yaw;
+  updated_command.speed = out.speed;
+  updated_command.heave = out.heave;
+
+  if (ap_status_pub_.getNumSubscribers() > 0)
+  {
+    ap_status_pub_.publish(stat);
+  }
+}
+
+// dt is the time since the previous update, for the integral terms
+void doAutopilotUpdate( double dt )
+{
+  if (curr_auto_mode_ == aquacore::AutopilotModes::AP_OFF) {
+    AP_DISPLAY( "MODE 0 - Autopilot is disabled, not publishing cmd");
+    return;
+  }
+
+  if (curr_auto_mode_ == aquacore::AutopilotModes::AP_TRAJECTORY) {
+    updateTrajectoryTarget();
+  }
+  
+  // Parameters are read from a single snapshot for the whole update
+  const ParamsConstPtr params_snapshot = loadParams();
+  const AutopilotConfig& params = *params_snapshot;
+
+  // For safety default command is zero unless code explicitly changes it:
+  aquacore::Command updated_command;
+  AutopilotTraceStatus trace_status = AP_TRACE_ACTIVE;
+
+  ros::Duration target_age = ( ros::Time::now() - current_target_.header.stamp );
+  ros::Duration depth_age = (ros::Time::now() - last_depth_reading_time_);
+
+  updated_command.roll = 0.0;
+  updated_command.pitch = 0.0;
+  updated_command.yaw = 0.0;
+  updated_command.speed = 0.0;
+  updated_command.heave = 0.0;
+
+  if( !have_velocity_ )
+  {
+    AP_DISPLAY_STREAM( "Sending zero command because angular velocity not received yet. have_velocity_:"
+                      << have_velocity_  );
+    trace_status = AP_TRACE_NO_VELOCITY;
+    // Note, commands still zero here. Zero will be intentionally published
+  }
+  else if( !have_target_ || target_age > target_lifetime_ ) {
+    AP_DISPLAY_STREAM( "Sending zero command because no fresh target available. have_target_: "
+                      << have_target_ << " and target_age: " << target_age );
+    trace_status = AP_TRACE_NO_TARGET;
+
+    // Note, commands still zero here. Zero will be intentionally published
+  }
+  else if ( !have_depth_ || depth_age > depth_lifetime_ )
+  {
+    ROS_INFO_STREAM_THROTTLE( 1.0, "Sending zero command because no fresh depth reading. have_depth_: "
+                      << have_depth_ << " and depth_age: " << depth_age );
+    trace_status = AP_TRACE_NO_DEPTH;
+    // Note, commands still zero here. Zero will be intentionally published
+  }
+  else
+  {
+
+    // This block is where all of the actual control commands are calculated. Our inputs are good, git going.
+    double target_r_in_global, target_p_in_global, target_y_in_global;
+    double curr_r_in_global, curr_p_in_global, curr_y_in_global;
+    // First step, basic parsing of the target and retrieve the IMU data
+    tf::quaternionMsgToTF(current_target_.pose.orientation, rotation_from_target_to_global_);
+    getRPY(rotation_from_target_to_global_, target_r_in_global, target_p_in_global, target_y_in_global);
+    AP_DISPLAY( "Fresh user target is:\n   speed:%f\n   heave:%f   depth:%f\n   roll:%f   pitch:%f   yaw:%f\n   age: %f.",
+              current_target_.pose.position.x, current_target_.pose.position.y, current_target_.pose.position.z,
+              180.0/PI*target_r_in_global, 180.0/PI*target_p_in_global, 180.0/PI*target_y_in_global,
+              target_age.toSec() );
+
+    stat.roll_target = 180.0/PI*target_r_in_global;
+    stat.pitch_target = 180.0/PI*target_p_in_global;
+    stat.yaw_target = 180.0/PI*target_y_in_global;
+
+    try
+    {
+
+      // Can block until the transform is available if want one for a specific time.
+      // This code was related to taking differences between angles at different times.
+      // Commented because we currently just get the latest, no matter what its time
+      // ros::Time now = ros::Time::now();
+      // ros::Duration one_tenth(0.1);
+      //listener_->waitForTransform("/aqua_base", "/latest_fix", now, one_tenth);
+      //listener_->lookupTransform("/aqua_base", "/latest_fix", ros::Time::now(), transform_from_global_to_imu);
+
+      lookupImuOrientation(rotation_from_imu_to_global_);
+      
+      getRPY(rotation_from_imu_to_global_, curr_r_in_global, curr_p_in_global, curr_y_in_global);
+      AP_DISPLAY( "Robot rotation in global frame:\n   roll: %f   pitch: %f   yaw: %f.",
+                180.0/PI*curr_r_in_global, 180.0/PI*curr_p_in_global, 180.0/PI*curr_y_in_global);
+
+      // Dave note: I had implemented this method to estimate the robot's velocities by taking
+      //            difference of angles over history. However, the IMU reads angular vel directly
+      //            so chose to use that at the moment, see velocityCallback etc
+//      // TODO: Verify with Phil and on the robot that these computed rates are somewhat similar to those
+//      //       input to the AP update function in RD
+//      tf::StampedTransform previous_transform;
+//      listener_->lookupTransform("/aqua_base", "/latest_fix", now - one_tenth, previous_transform);
+//      rotation_from_previous_imu_to_global_ = previous_transform.inverse().getRotation();
+//      tf::Quaternion rotation_from_previous_imu_to_current_imu_ = rotation_from_global_to_imu_ * rotation_from_previous_imu_to_global_;
+//      // TODO: R_P^C = R_G^C * R_P^G  (Florian verify?)
+//
+//      getRPY(rotation_from_previous_imu_to_current_imu_, r_rate_in_local_, p_rate_in_local_, y_rate_in_local_);
+//      AP_DISPLAY( "The robot is rotating at a rate of:\n   roll: %f   pitch: %f   yaw: %f.",
+//               180.0/PI*r_rate_in_local_, 180.0/PI*p_rate_in_local_, 180.0/PI*y_rate_in_local_);
+
+      // Now, process the command request based on the current target and mode from the user:
+
+      switch(curr_auto_mode_)
+      {
+      case aquacore::AutopilotModes::AP_OFF:
+
+        // MODE 0: Off
+        AP_DISPLAY( "MODE 0 - Autopilot is off, sending 0 commands.");
+        break;
+
+      case aquacore::AutopilotModes::AP_GLOBAL_ANGLES_LOCAL_THRUST:
+
+        // MODE 1: User commands all 3 angles in global frame (pass-through request to target). Speed and heave are in local frame (also pass-through).
+        AP_DISPLAY( "MODE %d - Global Angle Commands with Local Thrusts", curr_auto_mode_);
+        runControlLaw( false, dt, params, updated_command );
+        break;
+
+      case aquacore::AutopilotModes::AP_TRAJECTORY:
+        // MODE 5: same as MODE 4, with the target sampled from the loaded trajectory (see updateTrajectoryTarget)
+      case aquacore::AutopilotModes::AP_GLOBAL_ANGLES_FIXED_DEPTH:
+        // MODE 4: The robot tries to maintain a fixed depth by regulation with the depth sensor.
+        //         Target angle is interpreted in global frame.
+        //         Thrust command is local and must be planar so that it does not conflict with constant depth (TODO: how is this checked/reported?)
+        //         Depth regulation takes priority over target angles, so angles modified to keep depth steady.
+
+        AP_DISPLAY( "MODE %d - Depth Regulated Swimming at Global Target Angle.",curr_auto_mode_);
+        runControlLaw( true, dt, params, updated_command );
+        break;
+
+      default:
+        ROS_ERROR("WARNING: Autopilot mode %d is not yet implemented. Sending 0 commands.", curr_auto_mode_);
+        trace_status = AP_TRACE_UNSUPPORTED_MODE;
+        break;
+      }
+    }
+    catch (tf::TransformException ex)
+    {
+      ROS_ERROR("WARNING: TF exception: %s. Using old transformation information!!!",ex.what());
+      trace_status = AP_TRACE_NO_ORIENTATION;
+    }
+  }
+
+  publishCommand(updated_command, trace_status);
+}
+
+void publishCommand( const aquacore::Command& command, AutopilotTraceStatus trace_status )
+{
+  latest_cmd_ = command;
+  AP_DISPLAY( "Publishing command: r: %f, p: %f, y: %f, speed: %f, heave: %f",
+  latest_cmd_.roll, latest_cmd_.pitch, latest_cmd_.yaw,
+  latest_cmd_.speed, latest_cmd_.heave );
+
+  // publish by pointer, so that subscribers in the same process (nodelets) receive it without serialization
+  aquacore::CommandPtr& cmd_msg = nextCommandMessage();
+  *cmd_msg = latest_cmd_;
+  cmd_pub_.publish(cmd_msg);
+
+  if (trace_.isOpen())
+  {
+    traceUpdate(trace_status);
+  }
+}
+
+// Returns a pooled command message that no subscriber still holds, so that the
+// control tick does not allocate; allocates only while all of them are in use
+aquacore::CommandPtr& nextCommandMessage()
+{
+  for (int n = 0; n < CMD_MSG_POOL_SIZE; n++)
+  {
+    aquacore::CommandPtr& msg = cmd_msg_pool_[(cmd_msg_next_ + n) % CMD_MSG_POOL_SIZE];
+    if (msg && msg.unique())
+    {
+      cmd_msg_next_ = (cmd_msg_next_ + n + 1) % CMD_MSG_POOL_SIZE;
+      return msg;
+    }
+  }
+
+  aquacore::CommandPtr& msg = cmd_msg_pool_[cmd_msg_next_];
+  cmd_msg_next_ = (cmd_msg_next_ + 1) % CMD_MSG_POOL_SIZE;
+  msg.reset(new aquacore::Command());
+  return msg;
+}
+
+void traceUpdate( AutopilotTraceStatus status )
+{
+  AutopilotTraceRecord rec;
+  rec.stamp = ros::Time::now().toSec();
+  rec.mode = curr_auto_mode_;
+  rec.status = status;
+  rec.target_rpy[0] = stat.roll_target;
+  rec.target_rpy[1] = stat.pitch_target;
+  rec.target_rpy[2] = stat.yaw_target;
+  rec.current_rpy[0] = stat.current_roll;
+  rec.current_rpy[1] = stat.current_pitch;
+  rec.current_rpy[2] = stat.current_yaw;
+  rec.error_rpy[0] = stat.roll_error;
+  rec.error_rpy[1] = stat.pitch_error;
+  rec.error_rpy[2] = stat.yaw_error;
+  rec.command[0] = latest_cmd_.roll;
+  rec.command[1] = latest_cmd_.pitch;
+  rec.command[2] = latest_cmd_.yaw;
+  rec.command[3] = latest_cmd_.speed;
+  rec.command[4] = latest_cmd_.heave;
+  rec.depth = current_depth;
+  rec.depth_error = stat.depth_error;
+  rec.filtered_depth_derivative = filtered_depth_derivative_;
+  if (status != AP_TRACE_ACTIVE)
+  {
+    // stat still holds the values of the last active update
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    std::fill(rec.target_rpy, rec.target_rpy + 3, nan);
+    std::fill(rec.current_rpy, rec.current_rpy + 3, nan);
+    std::fill(rec.error_rpy, rec.error_rpy + 3, nan);
+    rec.depth_error = nan;
+  }
+  trace_.write(rec);
+}
+};
+
+#endif // AQUAAUTOPILOT_LOCAL_AUTOPILOT_H
@@ -0,0 +1,97 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef AQUAAUTOPILOT_ORIENTATION_SLOT_H
+#define AQUAAUTOPILOT_ORIENTATION_SLOT_H
+
+#include <atomic>
+#include <tf/LinearMath/Quaternion.h>
+
+/**
+ * Latest orientation reported by the IMU, shared between the IMU callback
+ * (single writer) and any number of readers without locking (seqlock).
+ *
+ * The writer makes the sequence number odd while it stores the quaternion;
+ * a reader retries if the sequence number was odd or changed while it was
+ * copying. The writer never waits, and readers only retry when they overlap
+ * a write.
+ */
+class OrientationSlot
+{
+public:
+  OrientationSlot() : seq_(0)
+  {
+    for (int i = 0; i < 4; i++)
+      q_[i].store(i == 3 ? 1.0 : 0.0, std::memory_order_relaxed);
+  }
+
+  // writer side
+  void write(const tf::Quaternion& q)
+  {
+    unsigned int s = seq_.load(std::memory_order_relaxed);
+    seq_.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    q_[0].store(q.x(), std::memory_order_relaxed);
+    q_[1].store(q.y(), std::memory_order_relaxed);
+    q_[2].store(q.z(), std::memory_order_relaxed);
+    q_[3].store(q.w(), std::memory_order_relaxed);
+    seq_.store(s + 2, std::memory_order_release);
+  }
+
+  // reader side: returns false if nothing was written yet
+  bool read(tf::Quaternion& q) const
+  {
+    unsigned int s;
+    double x, y, z, w;
+    for (;;)
+    {
+      s = seq_.load(std::memory_order_acquire);
+      if (s & 1)
+        continue;
+      x = q_[0].load(std::memory_order_relaxed);
+      y = q_[1].load(std::memory_order_relaxed);
+      z = q_[2].load(std::memory_order_relaxed);
+      w = q_[3].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq_.load(std::memory_order_relaxed) == s)
+        break;
+    }
+    q.setValue(x, y, z, w);
+    return s != 0;
+  }
+
+private:
+  std::atomic<unsigned int> seq_;
+  std::atomic<double> q_[4];
+};
+
+#endif // AQUAAUTOPILOT_ORIENTATION_SLOT_H
@@ -0,0 +1,221 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef AQUAAUTOPILOT_TRAJECTORY_H
+#define AQUAAUTOPILOT_TRAJECTORY_H
+
+#include <tf/LinearMath/Quaternion.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Target trajectory for the AP_TRAJECTORY autopilot mode.
+ *
+ * The keys are read once from a text file and interpolated with monotone
+ * cubic splines (PCHIP), which do not overshoot between keys. The result
+ * goes into a table with one sample per control period. Sampling during an
+ * update interpolates linearly between the two neighbouring entries (slerp
+ * for the orientation), so targets stay smooth when updates are not aligned
+ * with the table, e.g. with sensor-triggered updates.
+ *
+ * File format, one key per line, '#' starts a comment:
+ *   key T ROLL PITCH YAW DEPTH [SPEED HEAVE]
+ * T is seconds since the start, in increasing order. ROLL, PITCH and YAW are
+ * target angles in the global frame, in degrees. They are not wrapped, so
+ * several turns can be written as e.g. roll 0, 360, 720. DEPTH is in meters.
+ * SPEED and HEAVE are the thrusts of the target pose (position.x and
+ * position.y), and default to 0.
+ */
+class AutopilotTrajectory
+{
+public:
+  struct Sample
+  {
+    tf::Quaternion orientation;
+    double depth;
+    double speed;
+    double heave;
+  };
+
+  AutopilotTrajectory() : dt_(0.02), loop_(false) {}
+
+  bool load(const std::string& path, double dt, bool loop, std::string& error)
+  {
+    std::ifstream file(path.c_str());
+    if (!file)
+    {
+      error = "cannot open " + path;
+      return false;
+    }
+    if (!(dt > 0))
+    {
+      error = "invalid sample period";
+      return false;
+    }
+
+    std::vector<double> t, channels[CHANNELS];
+    std::string line;
+    for (int line_no = 1; std::getline(file, line); line_no++)
+    {
+      line = line.substr(0, line.find('#'));
+      std::istringstream in(line);
+      std::string keyword;
+      if (!(in >> keyword))
+        continue;
+
+      std::ostringstream where;
+      where << path << ":" << line_no << ": ";
+      double key_t, v[CHANNELS] = { 0, 0, 0, 0, 0, 0 };
+      if (keyword != "key" || !(in >> key_t >> v[ROLL] >> v[PITCH] >> v[YAW] >> v[DEPTH]))
+      {
+        error = where.str() + "expected 'key T ROLL PITCH YAW DEPTH [SPEED HEAVE]'";
+        return false;
+      }
+      if (in >> v[SPEED])
+        in >> v[HEAVE];
+      if (!t.empty() && key_t <= t.back())
+      {
+        error = where.str() + "key times must be increasing";
+        return false;
+      }
+      t.push_back(key_t);
+      for (int c = 0; c < CHANNELS; c++)
+        channels[c].push_back(v[c]);
+    }
+    if (t.empty())
+    {
+      error = path + " has no keys";
+      return false;
+    }
+    if ((t.back() - t.front()) / dt > MAX_SAMPLES)
+    {
+      error = path + " is too long";
+      return false;
+    }
+
+    std::vector<double> slopes[CHANNELS];
+    for (int c = 0; c < CHANNELS; c++)
+      computeSlopes(t, channels[c], slopes[c]);
+
+    size_t n = (size_t) std::floor((t.back() - t.front()) / dt + 1e-9) + 1;
+    samples_.resize(n);
+    size_t k = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+      double ti = t.front() + i * dt;
+      while (k + 2 < t.size() && ti > t[k+1])
+        k++;
+      double v[CHANNELS];
+      for (int c = 0; c < CHANNELS; c++)
+        v[c] = interpolate(t, channels[c], slopes[c], k, ti);
+
+      Sample& s = samples_[i];
+      s.orientation.setRPY(v[ROLL] * M_PI / 180.0, v[PITCH] * M_PI / 180.0, v[YAW] * M_PI / 180.0);
+      s.depth = v[DEPTH];
+      s.speed = v[SPEED];
+      s.heave = v[HEAVE];
+    }
+    dt_ = dt;
+    loop_ = loop;
+    return true;
+  }
+
+  double getDuration() const { return samples_.empty() ? 0.0 : (samples_.size() - 1) * dt_; }
+
+  // Target at elapsed seconds since the start; holds the last key when not looping
+  Sample sample(double elapsed) const
+  {
+    long n = samples_.size();
+    double x = std::max(0.0, elapsed / dt_);
+    if (loop_ && n > 1)
+      x = std::fmod(x, (double) (n - 1));
+    long i = (long) x;
+    if (i >= n - 1)
+      return samples_[n - 1];
+
+    const Sample& a = samples_[i];
+    const Sample& b = samples_[i + 1];
+    double f = x - i;
+    Sample s;
+    s.orientation = a.orientation.slerp(b.orientation, f);
+    s.depth = a.depth + f * (b.depth - a.depth);
+    s.speed = a.speed + f * (b.speed - a.speed);
+    s.heave = a.heave + f * (b.heave - a.heave);
+    return s;
+  }
+
+private:
+  enum { ROLL = 0, PITCH, YAW, DEPTH, SPEED, HEAVE, CHANNELS };
+  static const long MAX_SAMPLES = 1000000;
+
+  // Fritsch-Butland slopes: zero at local extrema, weighted harmonic mean elsewhere
+  static void computeSlopes(const std::vector<double>& t, const std::vector<double>& v, std::vector<double>& m)
+  {
+    size_t n = t.size();
+    m.assign(n, 0.0);
+    if (n < 2)
+      return;
+    m[0] = (v[1] - v[0]) / (t[1] - t[0]);
+    m[n-1] = (v[n-1] - v[n-2]) / (t[n-1] - t[n-2]);
+    for (size_t k = 1; k + 1 < n; k++)
+    {
+      double h0 = t[k] - t[k-1], h1 = t[k+1] - t[k];
+      double d0 = (v[k] - v[k-1]) / h0, d1 = (v[k+1] - v[k]) / h1;
+      if (d0 * d1 <= 0)
+        continue;
+      double w0 = 2*h1 + h0, w1 = h1 + 2*h0;
+      m[k] = (w0 + w1) / (w0/d0 + w1/d1);
+    }
+  }
+
+  static double interpolate(const std::vector<double>& t, const std::vector<double>& v,
+      const std::vector<double>& m, size_t k, double ti)
+  {
+    if (t.size() < 2)
+      return v[0];
+    double h = t[k+1] - t[k];
+    double s = std::min(1.0, std::max(0.0, (ti - t[k]) / h));
+    double s2 = s*s, s3 = s2*s;
+    return (2*s3 - 3*s2 + 1) * v[k] + (s3 - 2*s2 + s) * h * m[k]
+        + (3*s2 - 2*s3) * v[k+1] + (s3 - s2) * h * m[k+1];
+  }
+
+  std::vector<Sample> samples_;
+  double dt_;
+  bool loop_;
+};
+
+#endif // AQUAAUTOPILOT_TRAJECTORY_H
@@ -0,0 +1,142 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+/**
+ * Reads the binary trace of local_autopilot_node (see autopilot_trace.h) from
+ * shared memory and prints it as CSV, one line per autopilot update.
+ *
+ * Usage: autopilot_trace_dump [-n SHM_NAME] [-f]
+ *   -n  shared memory name given to the autopilot's ~trace_shm param
+ *       (default: /aquaautopilot_trace)
+ *   -f  keep following new records, like tail -f
+ */
+
+#include <aquaautopilot/autopilot_trace.h>
+#include <cstdio>
+#include <cstdlib>
+#include <getopt.h>
+
+
+static void printRecord(const AutopilotTraceRecord& r)
+{
+  printf("%.6f,%d,%d,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g\n",
+      r.stamp, r.mode, r.status,
+      r.target_rpy[0], r.target_rpy[1], r.target_rpy[2],
+      r.current_rpy[0], r.current_rpy[1], r.current_rpy[2],
+      r.error_rpy[0], r.error_rpy[1], r.error_rpy[2],
+      r.command[0], r.command[1], r.command[2], r.command[3], r.command[4],
+      r.depth, r.depth_error, r.filtered_depth_derivative);
+}
+
+
+int main(int argc, char** argv)
+{
+  std::string name = "/aquaautopilot_trace";
+  bool follow = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:f")) != -1)
+  {
+    switch (opt)
+    {
+    case 'n': name = optarg; break;
+    case 'f': follow = true; break;
+    default:
+      fprintf(stderr, "Usage: %s [-n SHM_NAME] [-f]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(AutopilotTraceHeader))
+  {
+    fprintf(stderr, "Cannot open trace %s; is the autopilot running with ~trace_shm set?\n", name.c_str());
+    return EXIT_FAILURE;
+  }
+  void* mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mem == MAP_FAILED)
+  {
+    perror("mmap");
+    return EXIT_FAILURE;
+  }
+
+  AutopilotTraceHeader* header = static_cast<AutopilotTraceHeader*>(mem);
+  if (header->magic != AutopilotTraceHeader::MAGIC || header->version != AutopilotTraceHeader::VERSION ||
+      header->record_size != sizeof(AutopilotTraceRecord) ||
+      (size_t) st.st_size < autopilotTraceSize(header->capacity))
+  {
+    fprintf(stderr, "%s is not a trace of this version of the autopilot\n", name.c_str());
+    return EXIT_FAILURE;
+  }
+  const uint64_t capacity = header->capacity;
+  AutopilotTraceSlot* slots = autopilotTraceSlots(header);
+
+  printf("stamp,mode,status,target_roll,target_pitch,target_yaw,current_roll,current_pitch,current_yaw,"
+      "roll_error,pitch_error,yaw_error,cmd_roll,cmd_pitch,cmd_yaw,cmd_speed,cmd_heave,"
+      "depth,depth_error,filtered_depth_derivative\n");
+
+  // start with the oldest record still in the ring
+  uint64_t next = header->head.load(std::memory_order_acquire), dropped = 0;
+  next = next > capacity ? next - capacity : 0;
+  do
+  {
+    uint64_t head = header->head.load(std::memory_order_acquire);
+    if (head > capacity && next < head - capacity)
+    {
+      dropped += head - capacity - next;
+      next = head - capacity;
+    }
+    for (; next < head; next++)
+    {
+      AutopilotTraceSlot& slot = slots[next % capacity];
+      uint64_t seq = slot.seq.load(std::memory_order_acquire);
+      AutopilotTraceRecord record = slot.record;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq != 2*next + 2 || slot.seq.load(std::memory_order_relaxed) != seq)
+      {
+        // overwritten by the writer while we were reading it
+        dropped++;
+        continue;
+      }
+      printRecord(record);
+    }
+    fflush(stdout);
+    if (follow)
+      usleep(10000);
+  } while (follow);
+
+  if (dropped > 0)
+    fprintf(stderr, "%llu records were overwritten before they could be read\n", (unsigned long long) dropped);
+  munmap(mem, st.st_size);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,601 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+/**
+ * Offline gain tuning for the 3D autopilot. Samples gain vectors at random in
+ * the given ranges, runs the control law (control_law.h) in closed loop with
+ * a reduced-order model of the robot on a set of scenarios, and prints the
+ * Pareto set of tracking error vs. control effort as CSV.
+ *
+ * The model is a first-order response of each body rate to its command,
+ *   d(rate)/dt = (gain * command - rate) / tau
+ * integrated into the orientation, and a velocity proportional to the speed
+ * and heave commands, rotated into the global frame, for the depth. Command
+ * gains are signed like the autopilot's gains in the launch files (a negative
+ * yaw command gain matches a negative YAW_P_GAIN). The rates and the depth
+ * derivative are filtered like in LocalAutopilot.
+ *
+ * Scenarios are the built-in steps, or the targets of recorded autopilot
+ * updates (CSV from autopilot_trace_dump), starting from the recorded state.
+ *
+ * Usage: autopilot_tune [options]
+ *   -g NAME=LO:HI  sample gain NAME in [LO, HI] (replaces the default ranges
+ *                  when given at least once)
+ *   -s NAME=VALUE  fix gain NAME; NAME is an AutopilotConfig gain or
+ *                  use_slerp / slerp_fraction
+ *   -m KEY=VALUE   model parameter: tau_roll, tau_pitch, tau_yaw, gain_roll,
+ *                  gain_pitch, gain_yaw, speed_gain, heave_gain, roll_filter,
+ *                  pitch_filter, yaw_filter, depth_filter, depth_weight
+ *   -t FILE        replay the targets of an autopilot_trace_dump CSV instead
+ *                  of the built-in scenarios
+ *   -n N           number of gain vectors (default: 4096)
+ *   -r SEED        random seed (default: 1)
+ *   -j THREADS     worker threads (default: hardware concurrency)
+ *   -a             print all gain vectors, with a pareto column
+ *   -v             print the model parameters and scenarios to stderr
+ */
+
+#include <aquaautopilot/control_law.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <getopt.h>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define PI 3.14159265359
+
+
+struct GainField
+{
+  const char* name;
+  double ControlGains::*field;
+};
+
+static const GainField GAIN_FIELDS[] = {
+  { "ROLL_P_GAIN", &ControlGains::ROLL_P_GAIN },
+  { "PITCH_P_GAIN", &ControlGains::PITCH_P_GAIN },
+  { "YAW_P_GAIN", &ControlGains::YAW_P_GAIN },
+  { "ROLL_I_GAIN", &ControlGains::ROLL_I_GAIN },
+  { "PITCH_I_GAIN", &ControlGains::PITCH_I_GAIN },
+  { "YAW_I_GAIN", &ControlGains::YAW_I_GAIN },
+  { "ROLL_D_GAIN", &ControlGains::ROLL_D_GAIN },
+  { "PITCH_D_GAIN", &ControlGains::PITCH_D_GAIN },
+  { "YAW_D_GAIN", &ControlGains::YAW_D_GAIN },
+  { "ROLL_CONST_GAIN", &ControlGains::ROLL_CONST_GAIN },
+  { "MAX_INTEGRAL_ANGLE_ERROR", &ControlGains::MAX_INTEGRAL_ANGLE_ERROR },
+  { "MAX_ROLL", &ControlGains::MAX_ROLL },
+  { "MAX_PITCH", &ControlGains::MAX_PITCH },
+  { "MAX_YAW", &ControlGains::MAX_YAW },
+  { "MAX_SPEED", &ControlGains::MAX_SPEED },
+  { "MAX_HEAVE", &ControlGains::MAX_HEAVE },
+  { "KDEPTH", &ControlGains::KDEPTH },
+  { "DEPTH_D_GAIN", &ControlGains::DEPTH_D_GAIN },
+  { "slerp_fraction", &ControlGains::slerp_fraction },
+};
+
+static const GainField* findGain(const std::string& name)
+{
+  for (size_t i = 0; i < sizeof(GAIN_FIELDS) / sizeof(GAIN_FIELDS[0]); i++)
+  {
+    if (name == GAIN_FIELDS[i].name)
+      return &GAIN_FIELDS[i];
+  }
+  return NULL;
+}
+
+struct GainRange
+{
+  const GainField* gain;
+  double lo, hi;
+};
+
+
+struct TuneModel
+{
+  double tau[3];          // s, time constant of the roll, pitch and yaw rates
+  double rate_gain[3];    // rad/s per unit command, at steady state
+  double speed_gain;      // m/s per unit speed command
+  double heave_gain;      // m/s per unit heave command
+  double rate_filter[3];  // s, ROLL/PITCH/YAW_D_FILTER_PERIOD
+  double depth_filter;    // s, DEPTH_D_FILTER_PERIOD
+  double depth_weight;    // rad of attitude error per m of depth error, in the tracking error
+
+  TuneModel()
+  {
+    tau[0] = 0.3; tau[1] = 0.4; tau[2] = 0.5;
+    rate_gain[0] = 2.0; rate_gain[1] = 1.5; rate_gain[2] = -1.0;
+    speed_gain = 0.6;
+    heave_gain = 0.3;
+    rate_filter[0] = rate_filter[1] = rate_filter[2] = 0.0;
+    depth_filter = 0.6;
+    depth_weight = 1.0;
+  }
+
+  bool set(const std::string& key, double value)
+  {
+    static const char* axes[3] = { "roll", "pitch", "yaw" };
+    for (int i = 0; i < 3; i++)
+    {
+      if (key == std::string("tau_") + axes[i]) { tau[i] = value; return true; }
+      if (key == std::string("gain_") + axes[i]) { rate_gain[i] = value; return true; }
+      if (key == std::string(axes[i]) + "_filter") { rate_filter[i] = value; return true; }
+    }
+    if (key == "speed_gain") { speed_gain = value; return true; }
+    if (key == "heave_gain") { heave_gain = value; return true; }
+    if (key == "depth_filter") { depth_filter = value; return true; }
+    if (key == "depth_weight") { depth_weight = value; return true; }
+    return false;
+  }
+};
+
+static void printModel(const TuneModel& m)
+{
+  fprintf(stderr, "model: tau_roll=%g tau_pitch=%g tau_yaw=%g gain_roll=%g gain_pitch=%g gain_yaw=%g\n"
+      "       speed_gain=%g heave_gain=%g roll_filter=%g pitch_filter=%g yaw_filter=%g\n"
+      "       depth_filter=%g depth_weight=%g\n",
+      m.tau[0], m.tau[1], m.tau[2], m.rate_gain[0], m.rate_gain[1], m.rate_gain[2],
+      m.speed_gain, m.heave_gain, m.rate_filter[0], m.rate_filter[1], m.rate_filter[2],
+      m.depth_filter, m.depth_weight);
+}
+
+
+// One autopilot update of a scenario: the target, as in /aqua/target_pose
+struct ScenarioStep
+{
+  ControlQuaternion target;
+  double speed, heave, depth;
+  bool regulate_depth;
+};
+
+struct Scenario
+{
+  std::string name;
+  double dt;
+  ControlQuaternion initial_orientation;
+  double initial_depth;
+  std::vector<ScenarioStep> steps;
+};
+
+static Scenario makeScenario(const std::string& name, double duration, bool regulate_depth,
+    double roll, double pitch, double yaw, double speed, double depth)
+{
+  Scenario s;
+  s.name = name;
+  s.dt = 0.02;
+  s.initial_depth = 2.0;
+  ScenarioStep step;
+  step.target = ControlQuaternion::fromRPY(roll * PI/180.0, pitch * PI/180.0, yaw * PI/180.0);
+  step.speed = speed;
+  step.heave = 0.0;
+  step.depth = depth;
+  step.regulate_depth = regulate_depth;
+  s.steps.assign((size_t) (duration / s.dt), step);
+  return s;
+}
+
+static std::vector<Scenario> builtinScenarios()
+{
+  std::vector<Scenario> scenarios;
+  scenarios.push_back(makeScenario("roll_step", 8.0, false, 30.0, 0.0, 0.0, 0.3, 2.0));
+  scenarios.push_back(makeScenario("pitch_step", 8.0, false, 0.0, 20.0, 0.0, 0.3, 2.0));
+  scenarios.push_back(makeScenario("yaw_step", 10.0, false, 0.0, 0.0, 90.0, 0.3, 2.0));
+  scenarios.push_back(makeScenario("depth_step", 20.0, true, 0.0, 0.0, 0.0, 0.6, 4.0));
+
+  // slow corkscrew: yaw sweep with a roll oscillation, at constant depth
+  Scenario cork = makeScenario("corkscrew", 20.0, true, 0.0, 0.0, 0.0, 0.6, 2.0);
+  for (size_t i = 0; i < cork.steps.size(); i++)
+  {
+    double t = i * cork.dt;
+    cork.steps[i].target = ControlQuaternion::fromRPY(0.5 * sin(2.0*PI*t / 5.0), 0.0, 2.0*PI*t / 20.0);
+  }
+  scenarios.push_back(cork);
+  return scenarios;
+}
+
+// Reads the active updates of an autopilot_trace_dump CSV. The targets are
+// replayed; speed and heave are the recorded (limited) commands
+static bool loadTraceScenario(const std::string& path, Scenario& s, std::string& error)
+{
+  std::ifstream in(path.c_str());
+  if (!in)
+  {
+    error = "cannot open " + path;
+    return false;
+  }
+
+  std::string line;
+  std::vector<std::string> columns;
+  if (!std::getline(in, line))
+  {
+    error = path + " is empty";
+    return false;
+  }
+  std::stringstream header(line);
+  std::string column;
+  while (std::getline(header, column, ','))
+    columns.push_back(column);
+
+  static const char* needed[] = { "stamp", "mode", "status", "target_roll", "target_pitch", "target_yaw",
+      "current_roll", "current_pitch", "current_yaw", "cmd_speed", "cmd_heave", "depth", "depth_error" };
+  const size_t n_needed = sizeof(needed) / sizeof(needed[0]);
+  size_t index[n_needed];
+  for (size_t i = 0; i < n_needed; i++)
+  {
+    index[i] = std::find(columns.begin(), columns.end(), needed[i]) - columns.begin();
+    if (index[i] == columns.size())
+    {
+      error = path + " has no column " + needed[i];
+      return false;
+    }
+  }
+
+  s.name = path;
+  s.dt = 0.0;
+  s.steps.clear();
+  double first_stamp = 0.0, last_stamp = 0.0;
+  std::vector<double> values(columns.size());
+  while (std::getline(in, line))
+  {
+    std::stringstream fields(line);
+    size_t n = 0;
+    while (n < values.size() && std::getline(fields, column, ','))
+      values[n++] = atof(column.c_str());
+    if (n < values.size() || values[index[2]] != 0) // AP_TRACE_ACTIVE only
+      continue;
+
+    double deg = PI / 180.0;
+    ScenarioStep step;
+    step.target = ControlQuaternion::fromRPY(values[index[3]] * deg, values[index[4]] * deg, values[index[5]] * deg);
+    step.speed = values[index[9]];
+    step.heave = values[index[10]];
+    step.depth = values[index[11]] + values[index[12]];
+    step.regulate_depth = values[index[1]] == 4 || values[index[1]] == 5;
+    if (s.steps.empty())
+    {
+      s.initial_orientation = ControlQuaternion::fromRPY(values[index[6]] * deg, values[index[7]] * deg, values[index[8]] * deg);
+      s.initial_depth = values[index[11]];
+      first_stamp = values[index[0]];
+    }
+    last_stamp = values[index[0]];
+    s.steps.push_back(step);
+  }
+
+  if (s.steps.size() < 2)
+  {
+    error = path + " has fewer than 2 active autopilot updates";
+    return false;
+  }
+  s.dt = (last_stamp - first_stamp) / (s.steps.size() - 1);
+  return true;
+}
+
+
+struct TuneResult
+{
+  double tracking; // RMS attitude error (rad) + depth_weight * RMS depth error (m)
+  double effort;   // RMS of the roll, pitch and yaw commands
+  bool pareto;
+};
+
+static TuneResult evaluate(const ControlGains& gains, const TuneModel& model, const std::vector<Scenario>& scenarios)
+{
+  double attitude_sq = 0.0, depth_sq = 0.0, effort_sq = 0.0;
+  size_t n_attitude = 0, n_depth = 0;
+
+  for (size_t k = 0; k < scenarios.size(); k++)
+  {
+    const Scenario& s = scenarios[k];
+    ControlQuaternion q = s.initial_orientation;
+    double rate[3] = { 0.0, 0.0, 0.0 }, filtered_rate[3] = { 0.0, 0.0, 0.0 };
+    bool have_filtered_rate[3] = { false, false, false };
+    double depth = s.initial_depth, filtered_depth_derivative = 0.0;
+    bool have_filtered_depth_derivative = false;
+
+    ControlState state;
+    ControlInput in;
+    ControlOutput out;
+    in.dt = s.dt;
+    for (size_t i = 0; i < s.steps.size(); i++)
+    {
+      const ScenarioStep& step = s.steps[i];
+      in.target_to_global = step.target;
+      in.imu_to_global = q;
+      in.speed = step.speed;
+      in.heave = step.heave;
+      in.regulate_depth = step.regulate_depth;
+      in.target_depth = step.depth;
+      in.depth = depth;
+      in.filtered_depth_derivative = filtered_depth_derivative;
+      in.roll_rate = filtered_rate[0];
+      in.pitch_rate = filtered_rate[1];
+      in.yaw_rate = filtered_rate[2];
+      computeControl(gains, in, state, out);
+
+      ControlQuaternion error = out.target_to_global.inverse() * q;
+      double angle = 2.0 * acos(std::min(1.0, fabs(error.w)));
+      attitude_sq += angle * angle;
+      n_attitude++;
+      if (step.regulate_depth)
+      {
+        depth_sq += (step.depth - depth) * (step.depth - depth);
+        n_depth++;
+      }
+      effort_sq += out.roll * out.roll + out.pitch * out.pitch + out.yaw * out.yaw;
+
+      // model step
+      double command[3] = { out.roll, out.pitch, out.yaw };
+      for (int a = 0; a < 3; a++)
+      {
+        rate[a] += s.dt / model.tau[a] * (model.rate_gain[a] * command[a] - rate[a]);
+        applyExpFilter(model.rate_filter[a], s.dt, rate[a], have_filtered_rate[a], filtered_rate[a]);
+      }
+      double omega = sqrt(rate[0]*rate[0] + rate[1]*rate[1] + rate[2]*rate[2]);
+      if (omega > 1e-12)
+      {
+        q = q * ControlQuaternion::fromAxisAngle(rate[0], rate[1], rate[2], omega * s.dt);
+        q.normalize();
+      }
+
+      double v_in_imu_frame[3] = { model.speed_gain * out.speed, 0.0, model.heave_gain * out.heave };
+      double v_in_global_frame[3];
+      q.rotate(v_in_imu_frame, v_in_global_frame);
+      double last_depth = depth;
+      depth -= v_in_global_frame[2] * s.dt; // depth is positive down
+      applyExpFilter(model.depth_filter, s.dt, (depth - last_depth) / s.dt,
+          have_filtered_depth_derivative, filtered_depth_derivative);
+
+      if (out.nan_detected || !std::isfinite(depth) || !std::isfinite(q.w))
+      {
+        TuneResult diverged = { std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity(), false };
+        return diverged;
+      }
+    }
+  }
+
+  TuneResult result;
+  result.tracking = sqrt(attitude_sq / std::max<size_t>(n_attitude, 1)) +
+      model.depth_weight * sqrt(depth_sq / std::max<size_t>(n_depth, 1));
+  result.effort = sqrt(effort_sq / std::max<size_t>(n_attitude, 1));
+  result.pareto = false;
+  return result;
+}
+
+// Marks the results not dominated in (tracking, effort)
+static void markPareto(std::vector<TuneResult>& results)
+{
+  std::vector<size_t> order(results.size());
+  for (size_t i = 0; i < order.size(); i++)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), [&results](size_t a, size_t b)
+  {
+    if (results[a].tracking != results[b].tracking)
+      return results[a].tracking < results[b].tracking;
+    return results[a].effort < results[b].effort;
+  });
+
+  double best_effort = std::numeric_limits<double>::infinity();
+  for (size_t i = 0; i < order.size(); i++)
+  {
+    TuneResult& r = results[order[i]];
+    if (std::isfinite(r.tracking) && r.effort < best_effort)
+    {
+      r.pareto = true;
+      best_effort = r.effort;
+    }
+  }
+}
+
+
+static bool parseAssignment(const char* arg, std::string& name, std::string& value)
+{
+  const char* eq = strchr(arg, '=');
+  if (eq == NULL || eq == arg)
+    return false;
+  name.assign(arg, eq - arg);
+  value = eq + 1;
+  return true;
+}
+
+static void usage(const char* argv0)
+{
+  fprintf(stderr, "Usage: %s [-g NAME=LO:HI]... [-s NAME=VALUE]... [-m KEY=VALUE]... [-t TRACE_CSV]\n"
+      "          [-n SAMPLES] [-r SEED] [-j THREADS] [-a] [-v]\n", argv0);
+}
+
+int main(int argc, char** argv)
+{
+  ControlGains base;
+  TuneModel model;
+  std::vector<GainRange> ranges;
+  std::string trace_path;
+  size_t samples = 4096;
+  unsigned long seed = 1;
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  bool print_all = false, verbose = false;
+
+  int opt;
+  std::string name, value;
+  while ((opt = getopt(argc, argv, "g:s:m:t:n:r:j:av")) != -1)
+  {
+    switch (opt)
+    {
+    case 'g':
+    {
+      GainRange range;
+      if (!parseAssignment(optarg, name, value) || (range.gain = findGain(name)) == NULL ||
+          sscanf(value.c_str(), "%lf:%lf", &range.lo, &range.hi) != 2)
+      {
+        fprintf(stderr, "Bad gain range %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+      ranges.push_back(range);
+      break;
+    }
+    case 's':
+    {
+      const GainField* gain;
+      if (!parseAssignment(optarg, name, value))
+      {
+        fprintf(stderr, "Bad setting %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+      if (name == "use_slerp")
+        base.use_slerp = atoi(value.c_str()) != 0 || value == "true";
+      else if ((gain = findGain(name)) != NULL)
+        base.*(gain->field) = atof(value.c_str());
+      else
+      {
+        fprintf(stderr, "Unknown gain %s\n", name.c_str());
+        return EXIT_FAILURE;
+      }
+      break;
+    }
+    case 'm':
+      if (!parseAssignment(optarg, name, value) || !model.set(name, atof(value.c_str())))
+      {
+        fprintf(stderr, "Bad model parameter %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+      break;
+    case 't': trace_path = optarg; break;
+    case 'n': samples = strtoul(optarg, NULL, 10); break;
+    case 'r': seed = strtoul(optarg, NULL, 10); break;
+    case 'j': threads = std::max(1, atoi(optarg)); break;
+    case 'a': print_all = true; break;
+    case 'v': verbose = true; break;
+    default:
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (ranges.empty())
+  {
+    // the gains set in the launch files, with the same signs
+    static const char* names[] = { "ROLL_P_GAIN", "PITCH_P_GAIN", "YAW_P_GAIN", "ROLL_D_GAIN",
+        "PITCH_D_GAIN", "YAW_D_GAIN", "KDEPTH", "DEPTH_D_GAIN" };
+    static const double lo[] = { 0.0, 0.0, -5.0, 0.0, 0.0, -2.0, -2.0, -2.0 };
+    static const double hi[] = { 4.0, 4.0, 0.0, 2.0, 2.0, 0.0, 0.0, 0.0 };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+      GainRange range = { findGain(names[i]), lo[i], hi[i] };
+      ranges.push_back(range);
+    }
+  }
+
+  std::vector<Scenario> scenarios;
+  if (trace_path.empty())
+  {
+    scenarios = builtinScenarios();
+  }
+  else
+  {
+    Scenario recorded;
+    std::string error;
+    if (!loadTraceScenario(trace_path, recorded, error))
+    {
+      fprintf(stderr, "%s\n", error.c_str());
+      return EXIT_FAILURE;
+    }
+    scenarios.push_back(recorded);
+  }
+
+  if (verbose)
+  {
+    printModel(model);
+    for (size_t i = 0; i < scenarios.size(); i++)
+      fprintf(stderr, "scenario %s: %zu updates, dt=%g\n", scenarios[i].name.c_str(), scenarios[i].steps.size(), scenarios[i].dt);
+  }
+
+  // All gain vectors are drawn up front, so the results do not depend on the thread count
+  std::vector<ControlGains> candidates(samples, base);
+  std::mt19937_64 rng(seed);
+  for (size_t i = 0; i < samples; i++)
+  {
+    for (size_t k = 0; k < ranges.size(); k++)
+    {
+      std::uniform_real_distribution<double> dist(ranges[k].lo, ranges[k].hi);
+      candidates[i].*(ranges[k].gain->field) = dist(rng);
+    }
+  }
+
+  std::vector<TuneResult> results(samples);
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < std::min<size_t>(threads, samples); t++)
+  {
+    workers.push_back(std::thread([&]()
+    {
+      for (size_t i = next++; i < samples; i = next++)
+        results[i] = evaluate(candidates[i], model, scenarios);
+    }));
+  }
+  for (size_t t = 0; t < workers.size(); t++)
+    workers[t].join();
+
+  markPareto(results);
+
+  std::vector<size_t> order;
+  for (size_t i = 0; i < samples; i++)
+  {
+    if (print_all || results[i].pareto)
+      order.push_back(i);
+  }
+  std::sort(order.begin(), order.end(), [&results](size_t a, size_t b) { return results[a].tracking < results[b].tracking; });
+
+  printf("tracking,effort");
+  if (print_all)
+    printf(",pareto");
+  for (size_t k = 0; k < ranges.size(); k++)
+    printf(",%s", ranges[k].gain->name);
+  printf("\n");
+  for (size_t j = 0; j < order.size(); j++)
+  {
+    const TuneResult& r = results[order[j]];
+    printf("%g,%g", r.tracking, r.effort);
+    if (print_all)
+      printf(",%d", r.pareto ? 1 : 0);
+    for (size_t k = 0; k < ranges.size(); k++)
+      printf(",%g", candidates[order[j]].*(ranges[k].gain->field));
+    printf("\n");
+  }
+  return EXIT_SUCCESS;
+}
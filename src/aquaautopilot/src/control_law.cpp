@@ -0,0 +1,277 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <aquaautopilot/control_law.h>
+#include <algorithm>
+#include <cmath>
+
+#define PI 3.14159265359
+
+
+ControlQuaternion ControlQuaternion::fromRPY(double roll, double pitch, double yaw)
+{
+  double cr = cos(roll * 0.5), sr = sin(roll * 0.5);
+  double cp = cos(pitch * 0.5), sp = sin(pitch * 0.5);
+  double cy = cos(yaw * 0.5), sy = sin(yaw * 0.5);
+  return ControlQuaternion(sr * cp * cy - cr * sp * sy,
+                           cr * sp * cy + sr * cp * sy,
+                           cr * cp * sy - sr * sp * cy,
+                           cr * cp * cy + sr * sp * sy);
+}
+
+ControlQuaternion ControlQuaternion::fromAxisAngle(double ax, double ay, double az, double angle)
+{
+  double s = sin(angle * 0.5) / sqrt(ax*ax + ay*ay + az*az);
+  return ControlQuaternion(ax * s, ay * s, az * s, cos(angle * 0.5));
+}
+
+ControlQuaternion ControlQuaternion::operator*(const ControlQuaternion& q) const
+{
+  return ControlQuaternion(w * q.x + x * q.w + y * q.z - z * q.y,
+                           w * q.y + y * q.w + z * q.x - x * q.z,
+                           w * q.z + z * q.w + x * q.y - y * q.x,
+                           w * q.w - x * q.x - y * q.y - z * q.z);
+}
+
+ControlQuaternion ControlQuaternion::slerp(const ControlQuaternion& q, double t) const
+{
+  double dot = x * q.x + y * q.y + z * q.z + w * q.w;
+  double s = sqrt((x*x + y*y + z*z + w*w) * (q.x*q.x + q.y*q.y + q.z*q.z + q.w*q.w));
+  double theta = acos(std::min(1.0, fabs(dot) / s));
+  if (theta == 0.0)
+  {
+    return *this;
+  }
+
+  // along the shortest path, as tf::Quaternion::slerp
+  double d = 1.0 / sin(theta);
+  double s0 = sin((1.0 - t) * theta) * d;
+  double s1 = (dot < 0 ? -1.0 : 1.0) * sin(t * theta) * d;
+  return ControlQuaternion(x * s0 + q.x * s1, y * s0 + q.y * s1, z * s0 + q.z * s1, w * s0 + q.w * s1);
+}
+
+void ControlQuaternion::normalize()
+{
+  double n = sqrt(x*x + y*y + z*z + w*w);
+  x /= n; y /= n; z /= n; w /= n;
+}
+
+void ControlQuaternion::getRPY(double& roll, double& pitch, double& yaw) const
+{
+  double s = 2.0 / (x*x + y*y + z*z + w*w);
+  double xs = x * s, ys = y * s, zs = z * s;
+  double wx = w * xs, wy = w * ys, wz = w * zs;
+  double xx = x * xs, xy = x * ys, xz = x * zs;
+  double yy = y * ys, yz = y * zs, zz = z * zs;
+
+  double m00 = 1.0 - (yy + zz), m01 = xy - wz, m02 = xz + wy;
+  double m10 = xy + wz, m20 = xz - wy, m21 = yz + wx, m22 = 1.0 - (xx + yy);
+
+  if (fabs(m20) >= 1)
+  {
+    // gimbal lock
+    yaw = 0;
+    if (m20 < 0)
+    {
+      pitch = PI / 2.0;
+      roll = atan2(m01, m02);
+    }
+    else
+    {
+      pitch = -PI / 2.0;
+      roll = atan2(-m01, -m02);
+    }
+  }
+  else
+  {
+    pitch = -asin(m20);
+    double c = cos(pitch);
+    roll = atan2(m21 / c, m22 / c);
+    yaw = atan2(m10 / c, m00 / c);
+  }
+}
+
+void ControlQuaternion::rotate(const double v[3], double out[3]) const
+{
+  ControlQuaternion r = (*this) * ControlQuaternion(v[0], v[1], v[2], 0.0) * inverse();
+  out[0] = r.x;
+  out[1] = r.y;
+  out[2] = r.z;
+}
+
+
+ControlGains::ControlGains() :
+  ROLL_P_GAIN(1.0), PITCH_P_GAIN(2.0), YAW_P_GAIN(-3.5),
+  ROLL_I_GAIN(0.0), PITCH_I_GAIN(0.0), YAW_I_GAIN(0.0),
+  ROLL_D_GAIN(0.0), PITCH_D_GAIN(0.0), YAW_D_GAIN(0.0),
+  ROLL_CONST_GAIN(0.0),
+  MAX_INTEGRAL_ANGLE_ERROR(10.0),
+  MAX_ROLL(1.0), MAX_PITCH(1.0), MAX_YAW(1.0), MAX_SPEED(1.0), MAX_HEAVE(1.0),
+  KDEPTH(0.3), DEPTH_D_GAIN(0.0),
+  use_slerp(true),
+  slerp_fraction(0.3)
+{
+}
+
+ControlInput::ControlInput() :
+  speed(0), heave(0), regulate_depth(false), target_depth(0), depth(0),
+  filtered_depth_derivative(0), roll_rate(0), pitch_rate(0), yaw_rate(0), dt(0.02)
+{
+}
+
+
+static double limitVal(double val, double lower, double upper, bool& nan_detected)
+{
+  if (std::isnan(val))
+  {
+    nan_detected = true;
+    return 0.0;
+  }
+  return std::min(upper, std::max(lower, val));
+}
+
+static double clampPi(double angle)
+{
+  while (angle > PI)
+  {
+    angle -= PI * 2.0;
+  }
+  while (angle < -PI)
+  {
+    angle += PI * 2.0;
+  }
+  return angle;
+}
+
+void computeControl(const ControlGains& gains, const ControlInput& in, ControlState& state, ControlOutput& out)
+{
+  ControlDiagnostics& diag = out.diag;
+  out.nan_detected = false;
+  double r, p, y;
+
+  ControlQuaternion target_to_global = in.target_to_global;
+  target_to_global.getRPY(r, p, y);
+  diag.roll_target = 180.0/PI*r;
+  diag.pitch_target = 180.0/PI*p;
+  diag.yaw_target = 180.0/PI*y;
+
+  in.imu_to_global.getRPY(r, p, y);
+  diag.current_roll = 180.0/PI*r;
+  diag.current_pitch = 180.0/PI*p;
+  diag.current_yaw = 180.0/PI*y;
+
+  diag.depth_error = diag.depth_p_contrib = diag.depth_d_contrib = diag.depth_correction_angle = 0.0;
+  if (in.regulate_depth)
+  {
+    // Depth regulation takes priority over the target angles: the target is rotated
+    // towards the depth target, about the horizontal axis normal to the swimming direction
+    diag.depth_error = in.target_depth - in.depth;
+    diag.depth_p_contrib = gains.KDEPTH * diag.depth_error;
+    diag.depth_d_contrib = -gains.DEPTH_D_GAIN * in.filtered_depth_derivative;
+    diag.depth_correction_angle = limitVal(diag.depth_p_contrib + diag.depth_d_contrib, -PI/4.0, PI/4.0, out.nan_detected);
+
+    double v_in_imu_frame[3] = { in.speed, 0.0, in.heave };
+    double v_in_global_frame[3];
+    target_to_global.rotate(v_in_imu_frame, v_in_global_frame);
+    double axis_x = v_in_global_frame[1], axis_y = -v_in_global_frame[0];
+    if (axis_x*axis_x + axis_y*axis_y > 1e-6)
+    {
+      target_to_global = ControlQuaternion::fromAxisAngle(axis_x, axis_y, 0.0, diag.depth_correction_angle) * target_to_global;
+    }
+  }
+
+  target_to_global.getRPY(r, p, y);
+  diag.resultant_roll = 180.0/PI*r;
+  diag.resultant_pitch = 180.0/PI*p;
+  diag.resultant_yaw = 180.0/PI*y;
+  out.target_to_global = target_to_global;
+
+  // R_T^I = R_G^I * R_T^G
+  ControlQuaternion target_to_imu = in.imu_to_global.inverse() * target_to_global;
+  if (gains.use_slerp)
+  {
+    target_to_imu = ControlQuaternion().slerp(target_to_imu, gains.slerp_fraction);
+  }
+  target_to_imu.getRPY(r, p, y);
+  diag.roll_error = clampPi(r);
+  diag.pitch_error = clampPi(p);
+  diag.yaw_error = clampPi(y);
+
+  state.integral_roll = limitVal(state.integral_roll + diag.roll_error * in.dt,
+      -gains.MAX_INTEGRAL_ANGLE_ERROR, gains.MAX_INTEGRAL_ANGLE_ERROR, out.nan_detected);
+  state.integral_pitch = limitVal(state.integral_pitch + diag.pitch_error * in.dt,
+      -gains.MAX_INTEGRAL_ANGLE_ERROR, gains.MAX_INTEGRAL_ANGLE_ERROR, out.nan_detected);
+  state.integral_yaw = limitVal(state.integral_yaw + diag.yaw_error * in.dt,
+      -gains.MAX_INTEGRAL_ANGLE_ERROR, gains.MAX_INTEGRAL_ANGLE_ERROR, out.nan_detected);
+  diag.roll_error_integral = state.integral_roll;
+  diag.pitch_error_integral = state.integral_pitch;
+  diag.yaw_error_integral = state.integral_yaw;
+
+  diag.roll_p_contrib = gains.ROLL_P_GAIN * diag.roll_error;
+  diag.pitch_p_contrib = gains.PITCH_P_GAIN * diag.pitch_error;
+  diag.yaw_p_contrib = gains.YAW_P_GAIN * diag.yaw_error;
+
+  diag.roll_i_contrib = gains.ROLL_I_GAIN * state.integral_roll;
+  diag.pitch_i_contrib = gains.PITCH_I_GAIN * state.integral_pitch;
+  diag.yaw_i_contrib = gains.YAW_I_GAIN * state.integral_yaw;
+
+  diag.roll_d_contrib = -gains.ROLL_D_GAIN * in.roll_rate;
+  diag.pitch_d_contrib = -gains.PITCH_D_GAIN * in.pitch_rate;
+  diag.yaw_d_contrib = -gains.YAW_D_GAIN * in.yaw_rate;
+
+  diag.roll_const_contrib = gains.ROLL_CONST_GAIN * sin(PI/180.0*diag.current_roll);
+
+  out.roll = limitVal(diag.roll_p_contrib + diag.roll_i_contrib + diag.roll_d_contrib + diag.roll_const_contrib,
+      -gains.MAX_ROLL, gains.MAX_ROLL, out.nan_detected);
+  out.pitch = limitVal(diag.pitch_p_contrib + diag.pitch_i_contrib + diag.pitch_d_contrib,
+      -gains.MAX_PITCH, gains.MAX_PITCH, out.nan_detected);
+  out.yaw = limitVal(diag.yaw_p_contrib + diag.yaw_i_contrib + diag.yaw_d_contrib,
+      -gains.MAX_YAW, gains.MAX_YAW, out.nan_detected);
+
+  // TODO: Should we also apply PID on these values?
+  out.speed = limitVal(in.speed, -gains.MAX_SPEED, gains.MAX_SPEED, out.nan_detected);
+  out.heave = limitVal(in.heave, -gains.MAX_HEAVE, gains.MAX_HEAVE, out.nan_detected);
+}
+
+void applyExpFilter(double filter_time_constant, double sample_period, double current_data, bool &previous_valid, double &filter_value)
+{
+  if (fabs(filter_time_constant) < 0.0000001 || !previous_valid)
+  {
+    filter_value = current_data;
+    previous_valid = true;
+  }
+  else
+  {
+    double filter_gain = exp(-sample_period / filter_time_constant);
+    filter_value = filter_gain * filter_value + (1.0 - filter_gain) * current_data;
+  }
+}
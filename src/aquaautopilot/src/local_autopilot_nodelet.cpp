@@ -0,0 +1,69 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <boost/shared_ptr.hpp>
+#include <aquaautopilot/local_autopilot.h>
+
+namespace aquaautopilot
+{
+
+/**
+ * LocalAutopilot as a nodelet, so that it can share a process with the depth
+ * filter and the gait and exchange messages with them without serialization
+ * (see launch/auto_nodelet.launch). Callbacks run on the nodelet's
+ * single-threaded queue, like in local_autopilot_node, except for the sensor
+ * callbacks with ~control_trigger set (see LocalAutopilot).
+ */
+class LocalAutopilotNodelet : public nodelet::Nodelet
+{
+private:
+  boost::shared_ptr<LocalAutopilot> autopilot_;
+  ros::Timer dyncfg_sync_timer_;
+
+  virtual void onInit()
+  {
+    autopilot_.reset(new LocalAutopilot(getPrivateNodeHandle()));
+    // replaces the 30 Hz dynamic reconfigure sync of LocalAutopilot::spin()
+    dyncfg_sync_timer_ = getNodeHandle().createTimer(ros::Duration(1.0/30), &LocalAutopilotNodelet::syncDyncfg, this);
+  }
+
+  void syncDyncfg(const ros::TimerEvent& e)
+  {
+    autopilot_->syncDyncfg();
+  }
+};
+
+}
+
+PLUGINLIB_EXPORT_CLASS(aquaautopilot::LocalAutopilotNodelet, nodelet::Nodelet)
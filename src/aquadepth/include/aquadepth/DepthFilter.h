@@ -0,0 +1,290 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef AQUADEPTH_DEPTH_FILTER_H
+#define AQUADEPTH_DEPTH_FILTER_H
+
+#include <std_msgs/Bool.h>
+#include <std_msgs/Float32.h>
+#include <std_srvs/Empty.h>
+#include <aquacore/StateMsg.h>
+#include <dynamic_reconfigure/server.h>
+#include <aquadepth/DepthFilterConfig.h>
+#include <aquacore/EmptyBool.h>
+#include <aquacore/DepthEstimate.h>
+#include <aquadepth/DepthWindow.h>
+#include <aquadepth/SlidingMedian.h>
+#include <aquadepth/DepthKalmanFilter.h>
+#include <boost/thread/mutex.hpp>
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+typedef dynamic_reconfigure::Server<aquadepth::DepthFilterConfig> ReconfigureServer;
+
+
+/**
+ * A re-implementation of depth_filter.py
+ *
+ * NOTE: cannot find easy way to implement waitTillConstantDepth in roscpp,
+ *       since this service handler must be isolated from others, so that
+ *       node does not block. This might be doable with multi-threaded spinners,
+ *       or with service server that has a dedicated handler thread, but
+ *       good luck figuring out kinks with the former or the syntax of the latter:
+ *
+ *       http://www.ros.org/wiki/roscpp/Overview/Callbacks%20and%20Spinning
+ */
+class DepthFilter {
+public:
+#ifdef ENABLE_WAIT_TILL_CONSTANT_DEPTH
+  bool waitTillConstantDepth(std_srvs::Empty::Request& req,
+      std_srvs::Empty::Response& res) {
+    // WARNING: may likely block subsequent ROS callbacks!
+    constant_depth_off_mutex.lock();
+    constant_depth_off_mutex.unlock();
+    return true;
+  };
+#endif
+
+  bool hasReachedConstantDepth(aquacore::EmptyBool::Request& req,
+      aquacore::EmptyBool::Response& res) {
+    res.result = has_reached_constant_depth;
+    has_reached_constant_depth = false;
+    return true;
+  };
+
+  void dyncfgCB(aquadepth::DepthFilterConfig& config, uint32_t level) {
+    min_window_entries = config.min_window_entries;
+    window_size_sec = ros::Duration(config.window_size_sec);
+    cutoff_sigma_multiplier = config.cutoff_sigma_multiplier;
+    N_sigma_cutoff_m = config.N_sigma_cutoff_m;
+    kalman.setNoise(config.kalman_accel_noise, config.kalman_depth_noise);
+  };
+
+  void stateCB(const aquacore::StateMsg::ConstPtr& data) {
+    state_mutex.lock();
+    
+    // Remove outdated entries from sliding window, then add the new one; both
+    // update the window's mean and variance in constant time
+    size_t prev_num_entries = window.size();
+    window.expire(data->header.stamp, window_size_sec);
+    if (estimator == ESTIMATOR_MEDIAN) {
+      // the median holds the same entries, expiring in the same order
+      for (size_t i = window.size(); i < prev_num_entries; i++) {
+        median.pop();
+      }
+      median.push(data->Depth);
+    } else if (estimator == ESTIMATOR_KALMAN) {
+      double dt = kalman.isInitialized() ? (data->header.stamp - last_stamp).toSec() : 0.0;
+      kalman.update(dt, data->Depth);
+    }
+    window.push(data->header.stamp, data->Depth);
+    last_stamp = data->header.stamp;
+
+    size_t num_entries = window.size();
+    if ((int) num_entries > min_window_entries) {
+      double mean_depth = window.mean();
+      double stdev_depth = window.stdev();
+      constant_depth = (stdev_depth * cutoff_sigma_multiplier < N_sigma_cutoff_m);
+      //ROS_INFO("n: %d, u: %.4f, s: %.4f, c: %d", (int) num_entries, mean_depth, stdev_depth, constant_depth);
+
+      // Publish filtered depth (the mean, unless another estimator was selected); messages are published
+      // by pointer, so that subscribers in the same process (nodelets) receive them without serialization
+      aquacore::DepthEstimatePtr estimate_msg(new aquacore::DepthEstimate());
+      estimate_msg->header.stamp = data->header.stamp;
+      estimate_msg->depth = mean_depth;
+      estimate_msg->depth_stdev = stdev_depth;
+      estimate_msg->has_rate = false;
+      if (estimator == ESTIMATOR_MEDIAN) {
+        estimate_msg->depth = median.median();
+      } else if (estimator == ESTIMATOR_KALMAN) {
+        estimate_msg->depth = kalman.getDepth();
+        estimate_msg->depth_stdev = kalman.getDepthStdev();
+        estimate_msg->has_rate = true;
+        estimate_msg->depth_rate = kalman.getRate();
+        estimate_msg->depth_rate_stdev = kalman.getRateStdev();
+      }
+      depth_estimate_pub.publish(estimate_msg);
+
+      std_msgs::Float32Ptr filtered_depth_msg(new std_msgs::Float32());
+      filtered_depth_msg->data = estimate_msg->depth;
+      filtered_depth_pub.publish(filtered_depth_msg);
+
+      // Publish flag indicating whether depth is constant or not
+      std_msgs::BoolPtr constant_depth_msg(new std_msgs::Bool());
+      constant_depth_msg->data = constant_depth;
+      constant_depth_pub.publish(constant_depth_msg);
+
+#ifdef ENABLE_WAIT_TILL_CONSTANT_DEPTH
+      // Update constant-depth-OFF mutex
+      if (!has_prev_constant_depth) {
+        if (!constant_depth) {
+          constant_depth_off_mutex.lock();
+        }
+      } else if (constant_depth && !prev_constant_depth) {
+        constant_depth_off_mutex.unlock();
+      } else if (!constant_depth && prev_constant_depth) {
+        constant_depth_off_mutex.lock();
+      }
+      prev_constant_depth = constant_depth;
+      has_prev_constant_depth = true;
+#endif
+
+      if (constant_depth) {
+        has_reached_constant_depth = true;
+      }
+    } // if (num_entries > min_window_entries)
+    
+    state_mutex.unlock();
+  };
+  
+  bool resetHandler(std_srvs::Empty::Request& req,
+      std_srvs::Empty::Response& res) {
+    reset();
+    return true;
+  };
+  
+  void reset() {
+    state_mutex.lock();
+    
+    constant_depth = false;
+#ifdef ENABLE_WAIT_TILL_CONSTANT_DEPTH
+    prev_constant_depth = false;
+    has_prev_constant_depth = false;
+#endif
+    has_reached_constant_depth = false;
+  
+    window.clear();
+    median.clear();
+    kalman.reset();
+    
+    state_mutex.unlock();
+  };
+
+  // nh is the private node handle; topic and service names are absolute
+  explicit DepthFilter(const ros::NodeHandle& private_nh = ros::NodeHandle("~")) : nh(private_nh),
+      constant_depth(false),
+#ifdef ENABLE_WAIT_TILL_CONSTANT_DEPTH
+      prev_constant_depth(false), has_prev_constant_depth(false),
+#endif
+      has_reached_constant_depth(false) {
+    double _window_size_sec;
+    nh.param<int>("min_window_entries", min_window_entries, 4);
+    nh.param<double>("window_size_sec", _window_size_sec, 2.0);
+    nh.param<double>("cutoff_sigma_multiplier", cutoff_sigma_multiplier, 3);
+    nh.param<double>("N_sigma_cutoff_m", N_sigma_cutoff_m, 0.15);
+    window_size_sec = ros::Duration(_window_size_sec);
+
+    // mean: windowed mean (as depth_filter.py); median: windowed median, robust
+    // to outliers; kalman: constant-velocity filter, also estimating the depth rate
+    std::string estimator_name;
+    double kalman_accel_noise, kalman_depth_noise;
+    nh.param<std::string>("estimator", estimator_name, "mean");
+    nh.param<double>("kalman_accel_noise", kalman_accel_noise, 0.5);
+    nh.param<double>("kalman_depth_noise", kalman_depth_noise, 0.05);
+    kalman.setNoise(kalman_accel_noise, kalman_depth_noise);
+    if (estimator_name == "median") {
+      estimator = ESTIMATOR_MEDIAN;
+    } else if (estimator_name == "kalman") {
+      estimator = ESTIMATOR_KALMAN;
+    } else {
+      if (estimator_name != "mean") {
+        ROS_WARN_STREAM("Unknown depth estimator " << estimator_name << ". Using the mean.");
+      }
+      estimator = ESTIMATOR_MEAN;
+    }
+
+    filtered_depth_pub = nh.advertise<std_msgs::Float32>("/aqua/filtered_depth", 100);
+    constant_depth_pub = nh.advertise<std_msgs::Bool>("/aqua/constant_depth_flag", 100);
+    depth_estimate_pub = nh.advertise<aquacore::DepthEstimate>("/aqua/depth_estimate", 100);
+    constant_depth_query_svc = nh.advertiseService(
+        "/aqua/has_reached_constant_depth", &DepthFilter::hasReachedConstantDepth, this);
+    state_sub = nh.subscribe("/aqua/state", 100, &DepthFilter::stateCB, this);
+
+    reset_svc = nh.advertiseService("reset", &DepthFilter::resetHandler, this);
+
+#ifdef ENABLE_WAIT_TILL_CONSTANT_DEPTH
+    constant_depth_blocking_svc = nh.advertiseService(
+        "/aqua/wait_till_constant_depth", &DepthFilter::waitTillConstantDepth, this);
+#endif
+
+    dyncfg_server = new ReconfigureServer(dyncfg_mutex, nh);
+    dyncfg_server->setCallback(bind(&DepthFilter::dyncfgCB, this, _1, _2));
+    
+    reset();
+  };
+
+
+protected:
+  ros::NodeHandle nh;
+
+  bool constant_depth;
+#ifdef ENABLE_WAIT_TILL_CONSTANT_DEPTH
+  bool prev_constant_depth;
+  bool has_prev_constant_depth;
+#endif
+  bool has_reached_constant_depth;
+
+  int min_window_entries;
+  ros::Duration window_size_sec;
+  double cutoff_sigma_multiplier;
+  double N_sigma_cutoff_m;
+
+  enum Estimator { ESTIMATOR_MEAN, ESTIMATOR_MEDIAN, ESTIMATOR_KALMAN };
+  Estimator estimator;
+
+  DepthWindow window;
+  SlidingMedian median;
+  DepthKalmanFilter kalman;
+  ros::Time last_stamp;
+#ifdef ENABLE_WAIT_TILL_CONSTANT_DEPTH
+  boost::mutex constant_depth_off_mutex;
+#endif
+
+  boost::mutex state_mutex;
+
+  ros::Publisher filtered_depth_pub;
+  ros::Publisher constant_depth_pub;
+  ros::Publisher depth_estimate_pub;
+  ros::ServiceServer reset_svc;
+#ifdef ENABLE_WAIT_TILL_CONSTANT_DEPTH
+  ros::ServiceServer constant_depth_blocking_svc;
+#endif
+  ros::ServiceServer constant_depth_query_svc;
+  ros::Subscriber state_sub;
+
+  ReconfigureServer* dyncfg_server;
+  boost::recursive_mutex dyncfg_mutex;
+};
+
+
+#endif // AQUADEPTH_DEPTH_FILTER_H
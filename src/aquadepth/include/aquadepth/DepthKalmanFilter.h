@@ -0,0 +1,118 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef AQUADEPTH_DEPTH_KALMAN_FILTER_H
+#define AQUADEPTH_DEPTH_KALMAN_FILTER_H
+
+#include <algorithm>
+#include <cmath>
+
+
+/**
+ * Constant-velocity Kalman filter on the depth readings, estimating depth
+ * and depth rate together. The rate is driven by white acceleration noise
+ * (accel_noise, m/s^2), and readings have a constant noise (depth_noise, m).
+ *
+ * Unlike differentiating a windowed mean, the rate estimate has no window
+ * delay: its lag is set by the ratio of the two noise levels.
+ */
+class DepthKalmanFilter {
+public:
+  DepthKalmanFilter(double accel_noise = 0.5, double depth_noise = 0.05) :
+      accel_noise(accel_noise), depth_noise(depth_noise) {
+    reset();
+  };
+
+  void setNoise(double accel_noise, double depth_noise) {
+    this->accel_noise = accel_noise;
+    this->depth_noise = depth_noise;
+  };
+
+  void reset() {
+    initialized = false;
+    depth = 0.0;
+    rate = 0.0;
+    p_dd = p_dr = p_rr = 0.0;
+  };
+
+  bool isInitialized() const { return initialized; };
+
+  // dt: time since the previous reading (s); readings with dt < 0 only update
+  void update(double dt, double measured_depth) {
+    double r = depth_noise * depth_noise;
+    if (!initialized) {
+      depth = measured_depth;
+      rate = 0.0;
+      p_dd = r;
+      p_dr = 0.0;
+      p_rr = 1.0; // (m/s)^2, until the second reading
+      initialized = true;
+      return;
+    }
+
+    // Predict: x = F x, P = F P F' + Q, with F = [1 dt; 0 1]
+    if (dt > 0.0) {
+      double q = accel_noise * accel_noise;
+      double dt2 = dt * dt;
+      depth += rate * dt;
+      p_dd += dt * (2.0 * p_dr + dt * p_rr) + q * dt2 * dt2 / 4.0;
+      p_dr += dt * p_rr + q * dt2 * dt / 2.0;
+      p_rr += q * dt2;
+    }
+
+    // Update with the reading, H = [1 0]
+    double s = p_dd + r;
+    double k_d = p_dd / s;
+    double k_r = p_dr / s;
+    double innovation = measured_depth - depth;
+    depth += k_d * innovation;
+    rate += k_r * innovation;
+    p_rr -= k_r * p_dr;
+    p_dr -= k_r * p_dd;
+    p_dd -= k_d * p_dd;
+  };
+
+  double getDepth() const { return depth; };
+  double getRate() const { return rate; };
+  double getDepthStdev() const { return sqrt(std::max(p_dd, 0.0)); };
+  double getRateStdev() const { return sqrt(std::max(p_rr, 0.0)); };
+
+protected:
+  double accel_noise;
+  double depth_noise;
+  bool initialized;
+  double depth, rate;
+  double p_dd, p_dr, p_rr; // symmetric covariance
+};
+
+
+#endif // AQUADEPTH_DEPTH_KALMAN_FILTER_H
@@ -0,0 +1,151 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef AQUADEPTH_DEPTH_WINDOW_H
+#define AQUADEPTH_DEPTH_WINDOW_H
+
+#include <ros/time.h>
+#include <vector>
+#include <utility>
+#include <cmath>
+
+typedef std::pair<ros::Time, float> EntryType;
+
+
+/**
+ * Sliding time window of depth readings, with the mean and variance kept up
+ * to date as readings enter and leave it (Welford's update and its inverse).
+ *
+ * Entries are stored in a ring buffer, which doubles when full and never
+ * shrinks, so that pushing and expiring are O(1) with no allocation once
+ * the buffer has grown to the window size. The moments are recomputed from
+ * the entries once in a while, so that rounding errors cannot build up.
+ */
+class DepthWindow {
+public:
+  explicit DepthWindow(size_t initial_capacity = 256) :
+      entries(initial_capacity > 0 ? initial_capacity : 1) {
+    clear();
+  };
+
+  void clear() {
+    head = 0;
+    count = 0;
+    mean_value = 0.0;
+    m2 = 0.0;
+    updates_since_resync = 0;
+  };
+
+  void push(const ros::Time& stamp, float value) {
+    if (count == entries.size()) {
+      grow();
+    }
+    entries[(head + count) % entries.size()] = std::make_pair(stamp, value);
+    count++;
+
+    double delta = value - mean_value;
+    mean_value += delta / count;
+    m2 += delta * (value - mean_value);
+    countUpdate();
+  };
+
+  // Drops the entries older than window_size before now
+  void expire(const ros::Time& now, const ros::Duration& window_size) {
+    while (count > 0 && now - entries[head].first > window_size) {
+      double value = entries[head].second;
+      head = (head + 1) % entries.size();
+      count--;
+
+      if (count == 0) {
+        mean_value = 0.0;
+        m2 = 0.0;
+      } else {
+        double delta = value - mean_value;
+        mean_value -= delta / count;
+        m2 -= delta * (value - mean_value);
+        if (m2 < 0.0) {
+          m2 = 0.0;
+        }
+      }
+      countUpdate();
+    }
+  };
+
+  size_t size() const { return count; };
+  double mean() const { return mean_value; };
+  // Population variance, as computed by depth_filter.py
+  double variance() const { return (count > 0) ? m2 / count : 0.0; };
+  double stdev() const { return sqrt(variance()); };
+
+protected:
+  void grow() {
+    std::vector<EntryType> larger(entries.size() * 2);
+    for (size_t i = 0; i < count; i++) {
+      larger[i] = entries[(head + i) % entries.size()];
+    }
+    entries.swap(larger);
+    head = 0;
+  };
+
+  void countUpdate() {
+    // O(window) every RESYNC_PERIOD updates, so still O(1) amortized
+    if (++updates_since_resync >= RESYNC_PERIOD) {
+      resync();
+    }
+  };
+
+  void resync() {
+    double sum = 0.0;
+    for (size_t i = 0; i < count; i++) {
+      sum += entries[(head + i) % entries.size()].second;
+    }
+    mean_value = (count > 0) ? sum / count : 0.0;
+    m2 = 0.0;
+    for (size_t i = 0; i < count; i++) {
+      double delta = entries[(head + i) % entries.size()].second - mean_value;
+      m2 += delta * delta;
+    }
+    updates_since_resync = 0;
+  };
+
+  static const size_t RESYNC_PERIOD = 1 << 16;
+
+  std::vector<EntryType> entries;
+  size_t head;
+  size_t count;
+  double mean_value;
+  double m2;
+  size_t updates_since_resync;
+};
+
+
+#endif // AQUADEPTH_DEPTH_WINDOW_H
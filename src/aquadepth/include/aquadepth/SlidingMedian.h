@@ -0,0 +1,216 @@
+/*******************************************************************************
+* DO NOT MODIFY - AUTO-GENERATED
+* 
+* Copyright (c) 2016, McGill University / Independent Robotics Inc.
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+* 
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+* 
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+* 
+* 3. Neither the name of the copyright holder nor the names of its contributors
+*    may be used to endorse or promote products derived from this software
+*    without specific prior written permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef AQUADEPTH_SLIDING_MEDIAN_H
+#define AQUADEPTH_SLIDING_MEDIAN_H
+
+#include <vector>
+#include <deque>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <stdint.h>
+
+
+/**
+ * Median of the readings in a FIFO window (see DepthWindow): readings are
+ * pushed at the back and popped from the front.
+ *
+ * The lower half is kept in a max-heap and the upper half in a min-heap.
+ * Each reading is tagged with its sequence number, so a popped reading is
+ * recognized by its number being below the front of the window; it is only
+ * dropped from its heap when it reaches the top. Push and pop are O(log n)
+ * amortized. The heaps are rebuilt when they hold as many popped readings as
+ * live ones, since with a drifting depth old readings may never reach the top.
+ */
+class SlidingMedian {
+public:
+  SlidingMedian() {
+    clear();
+  };
+
+  void clear() {
+    low.clear();
+    high.clear();
+    in_low.clear();
+    front_seq = 0;
+    next_seq = 0;
+    low_count = 0;
+    high_count = 0;
+  };
+
+  size_t size() const { return low_count + high_count; };
+
+  void push(float value) {
+    Entry entry(value, next_seq++);
+    bool to_low = (low_count == 0 || entry <= low.front());
+    in_low.push_back(to_low);
+    if (to_low) {
+      pushLow(entry);
+      low_count++;
+    } else {
+      pushHigh(entry);
+      high_count++;
+    }
+    rebalance();
+  };
+
+  // Removes the oldest reading
+  void pop() {
+    if (size() == 0) {
+      return;
+    }
+    bool was_low = in_low.front();
+    in_low.pop_front();
+    front_seq++;
+    if (was_low) {
+      low_count--;
+      pruneLow();
+    } else {
+      high_count--;
+      pruneHigh();
+    }
+    rebalance();
+
+    if (low.size() + high.size() > 2 * size() + 64) {
+      rebuild();
+    }
+  };
+
+  // Mean of the two middle readings for an even count; 0 when empty
+  double median() const {
+    if (low_count == 0) {
+      return 0.0;
+    }
+    if (low_count > high_count) {
+      return low.front().first;
+    }
+    return 0.5 * ((double) low.front().first + (double) high.front().first);
+  };
+
+protected:
+  // (value, sequence number); the number breaks ties, so that entries are unique
+  typedef std::pair<float, uint64_t> Entry;
+
+  void pushLow(const Entry& entry) {
+    low.push_back(entry);
+    std::push_heap(low.begin(), low.end(), std::less<Entry>());
+    in_low[entry.second - front_seq] = true;
+  };
+
+  void pushHigh(const Entry& entry) {
+    high.push_back(entry);
+    std::push_heap(high.begin(), high.end(), std::greater<Entry>());
+    in_low[entry.second - front_seq] = false;
+  };
+
+  Entry popLow() {
+    std::pop_heap(low.begin(), low.end(), std::less<Entry>());
+    Entry entry = low.back();
+    low.pop_back();
+    return entry;
+  };
+
+  Entry popHigh() {
+    std::pop_heap(high.begin(), high.end(), std::greater<Entry>());
+    Entry entry = high.back();
+    high.pop_back();
+    return entry;
+  };
+
+  // Drop popped readings from the tops, so that front() is always live
+  void pruneLow() {
+    while (!low.empty() && low.front().second < front_seq) {
+      popLow();
+    }
+  };
+
+  void pruneHigh() {
+    while (!high.empty() && high.front().second < front_seq) {
+      popHigh();
+    }
+  };
+
+  // Keeps low_count == high_count or high_count + 1
+  void rebalance() {
+    if (low_count > high_count + 1) {
+      pushHigh(popLow());
+      low_count--;
+      high_count++;
+      pruneLow();
+    } else if (low_count < high_count) {
+      pushLow(popHigh());
+      low_count++;
+      high_count--;
+      pruneHigh();
+    }
+  };
+
+  void rebuild() {
+    std::vector<Entry> entries;
+    entries.reserve(size());
+    for (size_t i = 0; i < low.size(); i++) {
+      if (low[i].second >= front_seq) {
+        entries.push_back(low[i]);
+      }
+    }
+    for (size_t i = 0; i < high.size(); i++) {
+      if (high[i].second >= front_seq) {
+        entries.push_back(high[i]);
+      }
+    }
+
+    std::sort(entries.begin(), entries.end());
+    low.clear();
+    high.clear();
+    low_count = (entries.size() + 1) / 2;
+    high_count = entries.size() - low_count;
+    for (size_t i = 0; i < entries.size(); i++) {
+      if (i < low_count) {
+        pushLow(entries[i]);
+      } else {
+        pushHigh(entries[i]);
+      }
+    }
+  };
+
+  std::vector<Entry> low;   // max-heap of the lower half
+  std::vector<Entry> high;  // min-heap of the upper half
+  std::deque<bool> in_low;  // for each live reading, from the oldest: whether it is in low
+  uint64_t front_seq;       // sequence number of the oldest live reading
+  uint64_t next_seq;
+  size_t low_count;         // live readings in low
+  size_t high_count;        // live readings in high
+};
+
+
+#endif // AQUADEPTH_SLIDING_MEDIAN_H